@@ -1,26 +1,60 @@
+#ifdef __APPLE__
 #include <GLUT/glut.h>
-#include <iostream>
 #include <OpenGL/gl.h>
 #include <OpenGL/glu.h>
+#include <OpenGL/glext.h>
+// The legacy context only has framebuffer objects and timer queries as extensions
+#define glGenFramebuffers glGenFramebuffersEXT
+#define glBindFramebuffer glBindFramebufferEXT
+#define glFramebufferRenderbuffer glFramebufferRenderbufferEXT
+#define glFramebufferTexture2D glFramebufferTexture2DEXT
+#define glCheckFramebufferStatus glCheckFramebufferStatusEXT
+#define glGenRenderbuffers glGenRenderbuffersEXT
+#define glBindRenderbuffer glBindRenderbufferEXT
+#define glRenderbufferStorage glRenderbufferStorageEXT
+#define glGetQueryObjectui64v glGetQueryObjectui64vEXT
+#define GL_FRAMEBUFFER GL_FRAMEBUFFER_EXT
+#define GL_FRAMEBUFFER_COMPLETE GL_FRAMEBUFFER_COMPLETE_EXT
+#define GL_RENDERBUFFER GL_RENDERBUFFER_EXT
+#define GL_COLOR_ATTACHMENT0 GL_COLOR_ATTACHMENT0_EXT
+#define GL_DEPTH_ATTACHMENT GL_DEPTH_ATTACHMENT_EXT
+#define GL_TIME_ELAPSED GL_TIME_ELAPSED_EXT
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/glut.h>
+#include <GL/gl.h>
+#include <GL/glu.h>
+#endif
+#ifdef MAZE_OFFSCREEN
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include <iostream>
+#include "maze_core.h"
 #include <vector>
 #include <random>
 #include <string>
 #include <cmath>
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-#include <ctime>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <cstdio>
+#include <cstring>
 
 // Window dimensions
 const int WINDOW_WIDTH = 800;
 const int WINDOW_HEIGHT = 600;
 
-// Global variables
-int MAZE_SIZE;
 int k; // Difficulty level (1=easy, 2=medium, 3=hard)
 
-// Function to get user input for difficulty
-void getDifficultyInput() {
+// Function to get user input for difficulty on the terminal (the window has its
+// own menu, headless runs fall back to medium). False when stdin ends or isn't a
+// number, leaving the difficulty unset.
+bool getDifficultyInput() {
     std::cout << "Select difficulty level:" << std::endl;
     std::cout << "1. Easy (10x10 maze)" << std::endl;
     std::cout << "2. Medium (15x15 maze)" << std::endl;
@@ -28,48 +62,366 @@ void getDifficultyInput() {
     std::cout << "Enter your choice (1-3): ";
 
     while (true) {
-        std::cin >> k;
-        if (k >= 1 && k <= 3) {
+        if (!(std::cin >> k)) {
+            std::cout << std::endl << "No difficulty given" << std::endl;
+            return false;
+        }
+        if (k >= DIFFICULTY_EASY && k <= DIFFICULTY_HARD) {
             break;
         }
         std::cout << "Invalid input. Please enter 1, 2, or 3: ";
     }
 
     // Set maze size based on difficulty
-    if (k == 1) {
-        MAZE_SIZE = 10;
-    }
-    else if (k == 2) {
-        MAZE_SIZE = 15;
-    }
-    else {
-        MAZE_SIZE = 20;
-    }
+    MAZE_SIZE = mazeSizeForDifficulty(k);
+    return true;
 }
 
-std::vector<std::vector<int>> maze;
-
-// Player settings
-float playerX = 1.5f;
-float playerY = 0.5f;
-float playerZ = 1.5f;
-float playerAngle = 0.0f;
-float playerLookUpDown = 0.0f;
-
-// Movement settings
-float cameraSpeed = 0.05f;
-float rotationSpeed = 3.0f;
+bool mazeSeedGiven = false;  // "--seed N", a random seed otherwise
+std::string recordPath;      // "--record FILE", written on exit
 
 // Game settings
-time_t gameStartTime;
-bool gameFinished = false;
 bool showMinimap = true;
-bool showCongratsMessage = false;
-int finalTime = 0;
+
+// Headless render benchmark ("--offscreen N", built with -DMAZE_OFFSCREEN): an
+// EGL context renders display() into a framebuffer object while the camera
+// follows the solution path. GLUT isn't initialised then - no window, no
+// glutSolidCube and no GLUT bitmap fonts (the HUD gets block glyphs instead).
+bool offscreenMode = false;
+int offscreenFrames = 0;            // frames to render, 0 for the whole path
+std::string offscreenDumpDir;       // "--dump-frames DIR", one PPM per frame
+const float OFFSCREEN_FRAME_RATE = 60.0f;   // nominal rate the camera path and timer are laid out for
+const float OFFSCREEN_WALK_SPEED = 2.5f;    // cells per second along the path
+GLuint offscreenFramebuffer = 0;
+
+// Input for the simulation thread that didn't fit in its queue (GLUT thread)
+uint64_t droppedInputs = 0;
+
+// Render side - the snapshot drawn this frame and the camera interpolated from it
+GameSnapshot frameState;
+std::chrono::steady_clock::time_point loopLastTime;
+float cameraX = 1.0f;
+float cameraZ = 1.0f;
+float cameraAngle = 0.0f;
+
+// Frame pacing - intervals between the most recent frames, in ms
+const int FRAME_INTERVAL_HISTORY = 240;
+float frameIntervals[FRAME_INTERVAL_HISTORY];
+int frameIntervalCount = 0;
+int frameIntervalNext = 0;
  
-// Key states - Updated to use special keys for arrows
+// Key states - the arrow keys are forwarded to the simulation as movement controls
 bool keyStates[256] = { false };
-bool specialKeyStates[256] = { false }; // For special keys like arrow keys
+
+// Baked maze geometry - built once after generateMaze() and kept on the GPU
+struct MazeVertex {
+    float x, y, z;      // position
+    float nx, ny, nz;   // normal used by the fixed-function lighting
+    float r, g, b;      // per-vertex colour (fed to GL_COLOR_MATERIAL)
+};
+
+struct MazeMesh {
+    std::vector<MazeVertex> vertices;
+    std::vector<unsigned int> indices;
+    int wallQuads = 0;
+    int floorQuads = 0;
+    int ceilingQuads = 0;
+};
+
+MazeMesh mazeMesh;
+GLuint mazeVertexBuffer = 0;
+GLuint mazeIndexBuffer = 0;
+bool useBakedMesh = true;   // 'B' switches back to the old per-cube path for comparison
+bool mazeMeshBaked = false;  // false when the maze is too big to bake as a whole
+const int MAX_BAKED_MAZE_SIZE = 512;
+
+// Baked lighting (bakeLighting() in maze_core.cpp) - vertex colours from the
+// ambient occlusion and the lanterns, with only the player's lantern left to
+// the fixed-function light. 'L' switches back to the lamp above the eye.
+MazeLighting mazeLighting;
+bool useBakedLighting = true;
+const float LANTERN_DRAW_DISTANCE = 16.0f;
+
+// Visibility culling - only open cells reachable by a ray from the camera inside
+// the field of view are drawn. Their geometry is rebuilt every frame into a
+// small streaming buffer, so frame cost follows the visible area, not maze size.
+const int VIEW_DISTANCE = 100;      // matches the far plane in reshape()
+const int VISIBILITY_RAYS = 512;
+bool useCulling = true;
+float viewAspect = (float)WINDOW_WIDTH / WINDOW_HEIGHT;
+std::vector<int> visibleCells;      // packed z * maze.width() + x of each visible open cell
+const int VISIBILITY_RADIUS = VIEW_DISTANCE + 2;   // a ray can end one cell past the far plane
+std::vector<uint32_t> visibleStamp; // window of (2 * VISIBILITY_RADIUS + 1)^2 cells around the player
+uint32_t visibilityFrame = 0;
+MazeMesh visibleMesh;
+GLuint visibleVertexBuffer = 0;
+GLuint visibleIndexBuffer = 0;
+
+// Potentially visible sets ("--pvs") - for every open cell, the cells that can be
+// seen from anywhere inside it, stored as runs of consecutive cell indices.
+// Identical sets (common along corridors) are stored once and shared.
+struct PvsRun {
+    uint32_t start;    // first cell index (z * (MAZE_SIZE + 2) + x)
+    uint32_t length;
+};
+
+struct PotentiallyVisibleSets {
+    std::vector<int32_t> cellSet;        // per cell: set id, -1 for walls
+    std::vector<uint32_t> setFirstRun;   // per set: offset into runs, plus one end entry
+    std::vector<PvsRun> runs;
+};
+
+const int PVS_RAYS = 1024;       // directions cast from every sample point
+const uint32_t PVS_FILE_VERSION = 1;
+PotentiallyVisibleSets pvs;
+bool pvsRequested = false;
+bool pvsLoaded = false;
+bool usePvs = true;              // 'V' switches between the PVS and per-frame rays
+
+// Hint overlay ('h') - the next steps towards the goal from the solver in maze_core
+const int HINT_STEPS = 12;          // grid cells of the path shown ahead of the player
+bool showHints = false;
+std::vector<int> hintPath;          // next cells towards the goal, starting at the player's cell
+int hintCellX = -1;                 // player cell the hint was computed for
+int hintCellZ = -1;
+int64_t hintWindowChunk = -1;
+uint32_t hintStepsToGoal = SOLVER_UNREACHABLE;
+
+// Minimap texture - the maze is rasterized once into a texture (one texel per
+// cell, or per square block of cells on huge mazes) and drawn as a single quad.
+// With fog of war ('f') texels stay dark until the player has stood next to
+// them, and entering a cell re-uploads just the texels around it.
+const int MINIMAP_TEXTURE_MAX_SIZE = 1024;
+GLuint minimapTexture = 0;
+bool minimapDirty = true;           // full rebuild before the next draw
+int minimapScale = 1;               // cells per texel along each axis
+int minimapTextureWidth = 0;
+int minimapTextureHeight = 0;
+std::vector<uint8_t> minimapPixels; // RGBA copy of the texture, source for sub-rectangle uploads
+bool fogOfWar = false;
+MazeGrid exploredCells;             // set bit = the player has been next to that cell
+int exploredCellX = -1;
+int exploredCellZ = -1;
+int64_t exploredWindowChunk = 0;    // endless window exploredCells is lined up with
+int exploredMinX = 0;               // cells explored since the last upload (empty when min > max)
+int exploredMinZ = 0;
+int exploredMaxX = -1;
+int exploredMaxZ = -1;
+
+// HUD text - the GLUT bitmap fonts are rendered once into a glyph atlas. Every
+// HUD string has a slot that caches its laid-out quads and is only rebuilt when
+// its text, position or colour changes; all slots in use go out in a single
+// draw at the end of the frame, in slot order. A slot can also hold a solid
+// quad (hudQuad()), drawn from a block of opaque texels kept in the atlas. 't' switches back to the old per-character
+// glutBitmapCharacter path for comparison.
+const int HUD_FONT_SMALL = 0;       // Helvetica 12
+const int HUD_FONT_MEDIUM = 1;      // Helvetica 18
+const int HUD_FONT_LARGE = 2;       // Times Roman 24
+const int HUD_FONT_COUNT = 3;
+
+const int HUD_TEXT_TIMER = 0;
+const int HUD_TEXT_HELP_1 = 1;
+const int HUD_TEXT_HELP_2 = 2;
+const int HUD_TEXT_HELP_3 = 3;
+const int HUD_TEXT_STATS = 4;
+const int HUD_TEXT_FRAME_TIME = 5;
+const int HUD_TEXT_MINIMAP_TITLE = 6;
+const int HUD_TEXT_CONGRATS_BACKGROUND = 7;    // a quad, under the congratulations text
+const int HUD_TEXT_CONGRATS_TITLE = 8;
+const int HUD_TEXT_CONGRATS_MESSAGE = 9;
+const int HUD_TEXT_CONGRATS_TIME = 10;
+const int HUD_TEXT_CONGRATS_CONTINUE = 11;
+const int HUD_TEXT_CUSTOM = 12;     // drawText()
+const int HUD_TEXT_FRAME_PACING = 13;
+const int HUD_TEXT_PROFILER = 14;   // header, then one line per PROFILE_* stage
+const int HUD_TEXT_LOADING_TITLE = HUD_TEXT_PROFILER + 1 + PROFILE_STAGE_COUNT;
+const int HUD_TEXT_LOADING_STATUS = HUD_TEXT_LOADING_TITLE + 1;
+const int HUD_TEXT_DIFFICULTY = HUD_TEXT_LOADING_STATUS + 1;    // one line per difficulty
+const int HUD_TEXT_RESOLUTION = HUD_TEXT_DIFFICULTY + DIFFICULTY_HARD;
+const int HUD_TEXT_HELP_4 = HUD_TEXT_RESOLUTION + 1;
+const int HUD_TEXT_SLOT_COUNT = HUD_TEXT_HELP_4 + 1;
+static_assert(HUD_TEXT_SLOT_COUNT <= 64, "drawHudText() keeps the slots in use as a 64-bit mask");
+
+// Atlas layout: 32x32 pixel cells, 16 per row, characters 32-127, one band of
+// six rows per font. Glyphs sit on a baseline 8 pixels up from the cell bottom.
+const int HUD_GLYPH_CELL = 32;
+const int HUD_GLYPH_BASELINE = 8;
+const int HUD_GLYPH_MARGIN = 4;     // room left of the pen for glyphs that start before it
+const int HUD_ATLAS_WIDTH = 512;
+const int HUD_ATLAS_HEIGHT = 1024;
+const int HUD_FONT_BAND_HEIGHT = 6 * HUD_GLYPH_CELL;
+const int HUD_SOLID_TEXELS = 4;     // opaque block in the atlas' top right corner, for hudQuad()
+
+// Inked pixels of a glyph inside its atlas cell, empty when x0 == x1
+struct HudGlyphBox {
+    uint8_t x0, y0, x1, y1;
+};
+
+struct HudTextVertex {
+    float x, y;
+    float u, v;
+    float r, g, b;
+};
+
+struct HudTextSlot {
+    std::string text;
+    float x = 0.0f, y = 0.0f;
+    float r = 0.0f, g = 0.0f, b = 0.0f;
+    float width = 0.0f, height = 0.0f;  // of a quad, 0 for text
+    int font = HUD_FONT_SMALL;
+    bool used = false;                  // queued this frame
+    std::vector<HudTextVertex> vertices;
+};
+
+GLuint hudAtlasTexture = 0;
+int hudGlyphAdvance[HUD_FONT_COUNT][128];
+HudGlyphBox hudGlyphBox[HUD_FONT_COUNT][128];
+HudTextSlot hudTextSlots[HUD_TEXT_SLOT_COUNT];
+std::vector<HudTextVertex> hudTextBatch;
+GLuint hudTextBuffer = 0;
+bool hudTextBatchDirty = true;
+uint64_t hudTextSlotsDrawn = 0;     // slots that made up the current batch
+bool useBatchedText = true;
+
+// Software renderer ("--renderer raycast", 'r' to switch) - the 3D view is
+// raycast on the CPU (raycastFrame() in maze_core) at the scene's resolution
+// and shown as one textured quad under the HUD. It draws walls, floor and
+// ceiling only; the start/goal markers and the hint trail are GL-only.
+bool useRaycaster = false;
+RaycastFrame raycastView;
+GLuint raycastTexture = 0;
+int raycastTextureWidth = 0;
+int raycastTextureHeight = 0;
+int viewWidth = WINDOW_WIDTH;
+int viewHeight = WINDOW_HEIGHT;
+
+// Dynamic resolution ("--frame-budget MS", 'd' to switch off) - below full
+// resolution the 3D view is drawn into sceneFramebuffer at sceneScale of the
+// window each way and stretched over the window as one linearly filtered quad
+// (a scaling glBlitFramebuffer is far slower on software GL), and the HUD goes
+// on top at the window's own resolution. The scale follows the cost of a
+// frame: the GPU time of display() from timer queries (read back a few frames
+// late, so nothing waits on them) or its CPU time, whichever is longer - the
+// raycaster works on the CPU. Offscreen, where software GL only renders at the
+// glFinish, the benchmark's own frame time up to the glFinish is used instead.
+// Every DRS_WINDOW_FRAMES the median cost is judged, so a single hitch doesn't
+// count: over budget the scale drops at once by the square root of the
+// overshoot (the cost goes with the pixel count), well under it the scale
+// creeps back up. Offscreen runs stay at full resolution unless given a
+// budget, so dumped frames can still be compared.
+const float DEFAULT_FRAME_BUDGET_MS = 16.6f;
+const float DRS_MIN_SCALE = 0.5f;
+const float DRS_LOWER_MARGIN = 1.05f;       // drop when the cost is this far over budget
+const float DRS_RAISE_HEADROOM = 0.85f;     // raise while the cost is under this share of it
+const float DRS_RAISE_STEP = 0.02f;
+const int DRS_WINDOW_FRAMES = 15;
+const int GPU_TIMER_QUERIES = 4;
+float frameBudgetMs = -1.0f;        // -1 until given: the default in a window, off offscreen
+bool useDynamicResolution = true;
+float sceneScale = 1.0f;
+int sceneWidth = WINDOW_WIDTH;      // size the 3D view is drawn at this frame
+int sceneHeight = WINDOW_HEIGHT;
+GLuint sceneFramebuffer = 0;
+GLuint sceneColorTexture = 0;
+GLuint sceneDepthBuffer = 0;
+int sceneBufferWidth = 0;
+int sceneBufferHeight = 0;
+GLuint gpuTimerQueries[GPU_TIMER_QUERIES];
+int gpuTimerNext = 0;
+int gpuTimerPending = 0;            // ended, result not read yet
+bool gpuTimerRunning = false;
+float gpuFrameMs = 0.0f;            // newest result read back
+float drsCosts[DRS_WINDOW_FRAMES];
+int drsCostFrames = 0;
+float frameCosts[FRAME_INTERVAL_HISTORY];   // ms, with the scale each frame was drawn at
+float frameScales[FRAME_INTERVAL_HISTORY];
+int frameCostCount = 0;
+int frameCostNext = 0;
+
+// Agents ("--agents N", simulated in maze_core) - drawn from the newest agent
+// snapshot as one batch of distance-attenuated points streamed into a buffer
+// each frame: a single draw call, as close to instancing as the fixed-function
+// pipeline gets. The raycaster doesn't draw them.
+const float AGENT_CHASER_FRACTION = 0.25f;
+const float AGENT_POINT_SIZE = 0.15f;   // world units
+const float AGENT_HEIGHT = 0.25f;       // points float at this height above the floor
+size_t agentCount = 0;
+
+struct AgentVertex {
+    float x, y, z;
+    uint8_t r, g, b, a;
+};
+
+std::vector<AgentVertex> agentVertices;
+GLuint agentVertexBuffer = 0;
+
+// Frame profiler ('p' overlay, "--trace FILE") - at the start of every frame the
+// events of the previous one are drained from the rings and summed per stage.
+// The overlay shows averages over the last PROFILE_HISTORY_FRAMES frames and is
+// only laid out again every PROFILE_OVERLAY_REFRESH_FRAMES, so its text slots
+// stay cached in between. Traces are kept in memory and written on exit.
+const int PROFILE_HISTORY_FRAMES = 120;
+const int PROFILE_OVERLAY_REFRESH_FRAMES = 30;
+const size_t PROFILE_TRACE_MAX_EVENTS = 1 << 21;
+bool showProfiler = false;
+std::string tracePath;
+std::vector<ProfileEvent> traceEvents;
+uint64_t profileStageNs[PROFILE_HISTORY_FRAMES][PROFILE_STAGE_COUNT];
+uint32_t profileStageCalls[PROFILE_HISTORY_FRAMES][PROFILE_STAGE_COUNT];
+int profileFrameNext = 0;
+int profileFrameCount = 0;
+int profileOverlayAge = 0;
+char profileOverlayLines[PROFILE_STAGE_COUNT + 1][128];
+
+// Levels - the window opens straight away and shows a difficulty menu (unless
+// "--size" or "--difficulty" chose already) and then a progress screen while
+// level 1 is built. A level is built as a JobGraph off the render thread: the
+// maze is generated first, then the baked mesh, the hint distance field, the
+// minimap image and (with "--pvs") the visible sets are built from it in
+// parallel. As soon as a level starts, the next one is built the same way, so
+// by the time SPACE is pressed on the congratulations screen it only has to be
+// swapped in. Levels go up a difficulty at a time up to hard ("--size" keeps
+// its size) with the seed counting up from the first one.
+struct PreparedLevel {
+    int number = 0;
+    int size = 0;
+    unsigned int seed = 0;
+    int generator = GENERATOR_DFS;
+    MazeGrid grid;
+    double generateMs = 0.0;            // 0 for a loaded maze
+    MazeLighting lighting;
+    MazeMesh mesh;
+    bool meshBaked = false;
+    bool meshLit = false;               // vertex colours from the lighting
+    MazeSolver solver;                  // distance field to the goal, empty when left to the first hint
+    size_t reachableCells = 0;
+    bool minimapFog = false;            // fog of war setting the image was made with
+    int minimapScale = 1;
+    int minimapWidth = 0;
+    int minimapHeight = 0;
+    std::vector<uint8_t> minimapPixels;
+    PotentiallyVisibleSets pvs;
+    bool pvsLoaded = false;
+    std::unique_ptr<JobGraph> jobs;
+};
+
+const unsigned LEVEL_BUILD_THREADS = 4;
+const int MAX_PREBUILT_DISTANCE_FIELD_SIZE = 2048;  // bigger ones wait for the first hint
+std::unique_ptr<PreparedLevel> nextLevel;   // being built, or built and waiting
+int currentLevel = 0;               // 0 until the first level is shown
+bool levelRequested = false;        // start nextLevel as soon as it is built
+bool difficultyChosen = false;      // levels step up through the difficulties
+int levelGenerator = -1;            // "--generator", -1 to pick by size
+unsigned int firstLevelSeed = 0;
+std::string saveMazePath;           // "--save FILE", the first level
+
+// CPU time spent in display(), smoothed, for the stats overlay
+double frameTimeMs = 0.0;
+
+// Render statistics for the 3D scene, reset at the start of every frame
+bool showStats = false;
+int frameDrawCalls = 0;
+int frameTriangles = 0;
 
 // Function prototypes
 void init();
@@ -79,43 +431,227 @@ void keyboard(unsigned char key, int x, int y);
 void keyboardUp(unsigned char key, int x, int y);
 void specialKeyboard(int key, int x, int y); // Added for arrow keys
 void specialKeyboardUp(int key, int x, int y); // Added for arrow keys
-void timer(int value);
-void generateMaze();
+void prepareLevel(int number, int size, unsigned int seed);
+void prepareLoadedLevel();
+void startLevel();
+void updateFrameState();
+float frameIntervalPercentile(float percentile);
+void collectProfileEvents();
+void saveTrace();
+int runReplay(const std::string& path);
+bool createOffscreenContext(int width, int height);
+int runOffscreenBenchmark();
+bool writeFramePpm(const std::string& path, int width, int height);
+void updateHints();
+void buildMazeMesh(const MazeGrid& grid, const MazeLighting* lighting, MazeMesh& mesh);
+void applyLighting();
+void uploadMazeMesh(const MazeMesh& mesh);
+void collectVisibleCells();
+void collectPvsCells();
+void buildPvs(const MazeGrid& grid, PotentiallyVisibleSets& sets);
+bool loadPvs(const MazeGrid& grid, unsigned int seed, PotentiallyVisibleSets& sets, const std::string& path);
+void savePvs(const MazeGrid& grid, unsigned int seed, const PotentiallyVisibleSets& sets, const std::string& path);
 void drawMaze();
+void drawMazeBuffers(GLuint vertexBuffer, GLuint indexBuffer, int indexCount);
+void drawMazeImmediate();
+void drawMazeMarkers();
+void drawAgents();
+void drawRaycastView();
+void drawHintPath();
+void updateExploredCells();
+void rasterizeMinimap(const MazeGrid& grid, const MazeGrid* explored, bool fog, int& scale, int& width, int& height,
+                      std::vector<uint8_t>& pixels);
+void uploadMinimapTexture();
+void updateMinimapTexture();
 void drawMinimap();
+void bakeHudFontAtlas();
+int hudTextWidth(int font, const char* text);
+void hudText(int slotIndex, float x, float y, int font, float r, float g, float b, const char* text);
+void hudQuad(int slotIndex, float x, float y, float width, float height, float r, float g, float b);
+void drawHudText();
 void drawTimer();
 void drawText(float x, float y, const char* text);
 void drawInstructions();
+void drawStats();
+void drawFrameCostGraph();
+void drawProfiler();
 void drawCongratsMessage();
-bool checkCollision(float x, float y, float z);
-void processMovement();
+void drawLoadingScreen();
 
 int main(int argc, char** argv)
 {
-    getDifficultyInput();
-    // Initialize GLUT
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
-    glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
-    glutCreateWindow("3D Maze - GLUT (Arrow Keys Only)");
-
-    // Register callbacks
-    glutDisplayFunc(display);
-    glutReshapeFunc(reshape);
-    glutKeyboardFunc(keyboard);
-    glutKeyboardUpFunc(keyboardUp);
-    glutSpecialFunc(specialKeyboard); // Added for arrow keys
-    glutSpecialUpFunc(specialKeyboardUp); // Added for arrow keys
-    glutTimerFunc(16, timer, 0); // ~60 FPS
+    // "--size N" picks an explicit maze size (e.g. very large mazes) and "--difficulty 1-3" a difficulty
+    // instead of asking for one,
+    // "--seed N" makes the maze reproducible, "--generator dfs|tiled" picks the generator
+    // "--endless" streams an infinite maze of that width and "--pvs" precomputes (or loads) visible sets.
+    // "--save FILE" writes the generated maze, "--load FILE [--verify]" maps a saved one instead.
+    // "--tick-rate N" sets the simulation rate in Hz (120 by default).
+    // "--record FILE" saves the input of the session on exit, "--replay FILE" re-runs one headless and checks it.
+    // "--trace FILE" profiles every frame and writes a Chrome trace on exit ('p' shows the profiler overlay).
+    // "--agents N" populates the maze with N wandering and chasing agents.
+    // "--renderer gl|raycast" picks the GPU renderer or the CPU raycaster for the 3D view.
+    // "--offscreen N [--dump-frames DIR]" renders N frames along the solution without a window and reports the frame rate.
+    // "--frame-budget MS" scales the 3D view's resolution to hold that frame time (16.6 by default, 0 for full resolution).
+    MAZE_SIZE = 0;
+    std::string loadMazePath;
+    bool verifyMazeFile = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) {
+            MAZE_SIZE = std::max(2, atoi(argv[++i]));
+            k = DIFFICULTY_HARD;
+        }
+        else if (arg == "--difficulty" && i + 1 < argc) {
+            k = std::max(DIFFICULTY_EASY, std::min(DIFFICULTY_HARD, atoi(argv[++i])));
+            MAZE_SIZE = mazeSizeForDifficulty(k);
+            difficultyChosen = true;
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            mazeSeed = (unsigned int)strtoul(argv[++i], NULL, 10);
+            mazeSeedGiven = true;
+        }
+        else if (arg == "--generator" && i + 1 < argc) {
+            mazeGenerator = std::string(argv[++i]) == "dfs" ? GENERATOR_DFS : GENERATOR_TILED;
+        }
+        else if (arg == "--save" && i + 1 < argc) {
+            saveMazePath = argv[++i];
+        }
+        else if (arg == "--load" && i + 1 < argc) {
+            loadMazePath = argv[++i];
+        }
+        else if (arg == "--verify") {
+            verifyMazeFile = true;
+        }
+        else if (arg == "--endless") {
+            endlessMode = true;
+        }
+        else if (arg == "--tick-rate" && i + 1 < argc) {
+            tickRate = std::max(1, atoi(argv[++i]));
+            tickSeconds = 1.0 / tickRate;
+        }
+        else if (arg == "--pvs") {
+            pvsRequested = true;
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc) {
+            return runReplay(argv[++i]);
+        }
+        else if (arg == "--offscreen" && i + 1 < argc) {
+            offscreenMode = true;
+            offscreenFrames = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--dump-frames" && i + 1 < argc) {
+            offscreenDumpDir = argv[++i];
+        }
+        else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+            profilerEnabled = true;
+        }
+        else if (arg == "--agents" && i + 1 < argc) {
+            agentCount = (size_t)std::max(0LL, atoll(argv[++i]));
+        }
+        else if (arg == "--renderer" && i + 1 < argc) {
+            useRaycaster = std::string(argv[++i]) == "raycast";
+        }
+        else if (arg == "--frame-budget" && i + 1 < argc) {
+            frameBudgetMs = std::max(0.0f, (float)atof(argv[++i]));
+        }
+    }
+    if (frameBudgetMs < 0.0f) {
+        frameBudgetMs = offscreenMode ? 0.0f : DEFAULT_FRAME_BUDGET_MS;
+    }
+    if (offscreenMode && endlessMode) {
+        std::cout << "The offscreen benchmark needs a fixed maze, not --endless" << std::endl;
+        return 1;
+    }
+    if (!loadMazePath.empty()) {
+        endlessMode = false;
+        if (!loadMazeFile(loadMazePath, verifyMazeFile)) {
+            return 1;
+        }
+    }
+    else {
+        // The window asks for the difficulty. Offscreen runs are often unattended,
+        // so they don't wait for one on stdin, and the endless maze has no levels
+        // to pick from the menu: both get the medium size.
+        if (MAZE_SIZE == 0 && (offscreenMode || endlessMode)) {
+            k = DIFFICULTY_MEDIUM;
+            MAZE_SIZE = mazeSizeForDifficulty(k);
+        }
+        if (!mazeSeedGiven) {
+            std::random_device rd;
+            mazeSeed = rd();
+        }
+    }
+    levelGenerator = mazeGenerator;
+    firstLevelSeed = mazeSeed;
+
+    if (offscreenMode) {
+        // Render into a framebuffer object instead of a window
+        if (!createOffscreenContext(WINDOW_WIDTH, WINDOW_HEIGHT)) {
+            return 1;
+        }
+    }
+    else {
+        // Initialize GLUT
+        glutInit(&argc, argv);
+        glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+        glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+        glutCreateWindow("3D Maze - GLUT (Arrow Keys Only)");
+
+        // Register callbacks
+        glutDisplayFunc(display);
+        glutReshapeFunc(reshape);
+        glutKeyboardFunc(keyboard);
+        glutKeyboardUpFunc(keyboardUp);
+        glutSpecialFunc(specialKeyboard); // Added for arrow keys
+        glutSpecialUpFunc(specialKeyboardUp); // Added for arrow keys
+    }
 
     // Initialize OpenGL
     init();
 
-    // Generate maze
-    generateMaze();
+    // The endless maze streams its own chunks and has no levels. Otherwise the
+    // first level is built in the background while the window shows progress
+    // (a loaded maze only needs its derived data); without a size the difficulty
+    // menu comes first and starts the build.
+    if (endlessMode) {
+        if (!startEndlessMaze(MAZE_SIZE, mazeSeed)) {
+            return 1;
+        }
+        std::cout << "Endless maze, width " << MAZE_SIZE << " (seed " << mazeSeed << "), window uses "
+                  << maze.memoryBytes() / 1024 << " KB" << std::endl;
+        if (agentCount > 0) {
+            std::cout << "Agents need a fixed maze, not --endless" << std::endl;
+        }
+    }
+    else if (!loadMazePath.empty()) {
+        prepareLoadedLevel();
+    }
+    else if (MAZE_SIZE != 0) {
+        prepareLevel(1, MAZE_SIZE, firstLevelSeed);
+    }
+    levelRequested = !endlessMode;
+
+    // Headless runs stop here - the camera is scripted, there is no simulation
+    if (offscreenMode) {
+        startLevel();
+        return runOffscreenBenchmark();
+    }
 
-    // Start game timer
-    gameStartTime = time(NULL);
+    // Endless sessions can't be recorded: the window slides with the frames, so
+    // a replay could see a different rebasing. Fixed mazes record from the first
+    // tick of level 1 (see startLevel()).
+    if (endlessMode) {
+        if (!recordPath.empty()) {
+            std::cout << "Input recording needs a fixed maze, not recording" << std::endl;
+        }
+        startSimulation();
+        currentLevel = 1;
+    }
+    loopLastTime = std::chrono::steady_clock::now();
 
     // Enter main loop
     glutMainLoop();
@@ -136,23 +672,248 @@ void init()
     glEnable(GL_LIGHT0);    //first open gl built-in lights
 
     // Set up light
-    GLfloat lightPosition[] = { 0.0f, 15.0f, 0.0f, 1.0f };  //tells the position of the light and 1.0f means the positional light
+    applyLighting();
+
+    // Enable color material
+    glEnable(GL_COLOR_MATERIAL);
+    glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);  //use the lights to show the effects to the objects
+
+    // Show cursor
+    if (!offscreenMode) {
+        glutSetCursor(GLUT_CURSOR_LEFT_ARROW);   //let the cursor look like the left arrow in the gameplay
+    }
+
+    // Glyph atlas for the HUD text
+    bakeHudFontAtlas();
+}
+
+// GL_LIGHT0 for the lighting in use. Positions are set in eye space, so the
+// light moves with the camera without being set again every frame.
+// - Baked: the global ambient of 1 passes the baked vertex colours through as
+//   they are, and the light is only the player's lantern - at the eye, warm
+//   and fading with distance.
+// - Otherwise the lamp 15 units above the eye the maze has always been lit with
+//   (the raycaster matches this one).
+void applyLighting()
+{
+    bool baked = useBakedLighting && mazeLighting.baked();
+    GLfloat lightPosition[] = { 0.0f, baked ? 0.0f : 15.0f, 0.0f, 1.0f };  //tells the position of the light and 1.0f means the positional light
     GLfloat lightAmbient[] = { 0.3f, 0.3f, 0.3f, 1.0f }; // used to create a ambiance of the light , dim light
     GLfloat lightDiffuse[] = { 0.7f, 0.7f, 0.7f, 1.0f };//diffused light to make the look 3d
+    GLfloat globalAmbient[] = { 0.2f, 0.2f, 0.2f, 1.0f };  // the GL default
+    if (baked) {
+        const GLfloat lanternDiffuse[] = { 0.55f, 0.45f, 0.3f, 1.0f };
+        for (int c = 0; c < 3; c++) {
+            lightAmbient[c] = 0.0f;
+            lightDiffuse[c] = lanternDiffuse[c];
+            globalAmbient[c] = 1.0f;
+        }
+    }
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
     glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
+    glPopMatrix();
     glLightfv(GL_LIGHT0, GL_AMBIENT, lightAmbient);
     glLightfv(GL_LIGHT0, GL_DIFFUSE, lightDiffuse);
+    glLightf(GL_LIGHT0, GL_QUADRATIC_ATTENUATION, baked ? 0.5f : 0.0f);
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, globalAmbient);
+}
 
-    // Enable color material
-    glEnable(GL_COLOR_MATERIAL);
-    glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);  //use the lights to show the effects to the objects
+// Rebuild the whole-maze mesh after the lighting was switched, its vertex
+// colours come from the bake
+static void rebuildMazeMesh()
+{
+    if (mazeMeshBaked) {
+        buildMazeMesh(maze, useBakedLighting && mazeLighting.baked() ? &mazeLighting : nullptr, mazeMesh);
+        uploadMazeMesh(mazeMesh);
+    }
+}
 
-    // Show cursor
-    glutSetCursor(GLUT_CURSOR_LEFT_ARROW);   //let the cursor look like the left arrow in the gameplay
+// GPU time of the whole frame. A timer query's result is read once it is
+// ready, usually a frame or two later; with all of them still in flight the
+// frame just goes untimed.
+static void beginFrameTimer()
+{
+    if (gpuTimerQueries[0] == 0) {
+        glGenQueries(GPU_TIMER_QUERIES, gpuTimerQueries);
+    }
+    while (gpuTimerPending > 0) {
+        GLuint query = gpuTimerQueries[(gpuTimerNext - gpuTimerPending + GPU_TIMER_QUERIES) % GPU_TIMER_QUERIES];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 elapsedNs = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedNs);
+        gpuFrameMs = (float)(elapsedNs / 1e6);
+        gpuTimerPending--;
+    }
+    gpuTimerRunning = gpuTimerPending < GPU_TIMER_QUERIES;
+    if (gpuTimerRunning) {
+        glBeginQuery(GL_TIME_ELAPSED, gpuTimerQueries[gpuTimerNext]);
+    }
+}
+
+static void endFrameTimer()
+{
+    if (gpuTimerRunning) {
+        glEndQuery(GL_TIME_ELAPSED);
+        gpuTimerNext = (gpuTimerNext + 1) % GPU_TIMER_QUERIES;
+        gpuTimerPending++;
+    }
+}
+
+// Size the 3D view for this frame. Below full resolution it is drawn into the
+// scene framebuffer (made or resized to the window here) and true is returned.
+static bool beginScene()
+{
+    float scale = useDynamicResolution && frameBudgetMs > 0.0f ? sceneScale : 1.0f;
+    sceneWidth = std::max(1, (int)lroundf(viewWidth * scale));
+    sceneHeight = std::max(1, (int)lroundf(viewHeight * scale));
+    if (sceneWidth == viewWidth && sceneHeight == viewHeight) {
+        return false;
+    }
+
+    if (sceneBufferWidth != viewWidth || sceneBufferHeight != viewHeight) {
+        if (sceneFramebuffer == 0) {
+            glGenTextures(1, &sceneColorTexture);
+            glGenRenderbuffers(1, &sceneDepthBuffer);
+            glGenFramebuffers(1, &sceneFramebuffer);
+        }
+        glBindTexture(GL_TEXTURE_2D, sceneColorTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, viewWidth, viewHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindRenderbuffer(GL_RENDERBUFFER, sceneDepthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, viewWidth, viewHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColorTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, sceneDepthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Scene framebuffer is incomplete, staying at full resolution" << std::endl;
+            glBindFramebuffer(GL_FRAMEBUFFER, offscreenFramebuffer);
+            frameBudgetMs = 0.0f;
+            sceneWidth = viewWidth;
+            sceneHeight = viewHeight;
+            return false;
+        }
+        sceneBufferWidth = viewWidth;
+        sceneBufferHeight = viewHeight;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glViewport(0, 0, sceneWidth, sceneHeight);
+    return true;
+}
+
+// Stretch the scene over the window (or the offscreen framebuffer) and draw
+// on there from now on
+static void resolveScene()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreenFramebuffer);
+    glViewport(0, 0, viewWidth, viewHeight);
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, 1, 0, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    // Only the corner the scene was drawn in, the texture is window-sized
+    float u = (float)sceneWidth / sceneBufferWidth;
+    float v = (float)sceneHeight / sceneBufferHeight;
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, sceneColorTexture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f);
+    glVertex2f(0.0f, 0.0f);
+    glTexCoord2f(u, 0.0f);
+    glVertex2f(1.0f, 0.0f);
+    glTexCoord2f(u, v);
+    glVertex2f(1.0f, 1.0f);
+    glTexCoord2f(0.0f, v);
+    glVertex2f(0.0f, 1.0f);
+    glEnd();
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
+}
+
+// Record the cost of this frame and, once a window of them is in, move the
+// scene scale towards the frame budget
+static void updateSceneScale(float costMs)
+{
+    frameCosts[frameCostNext] = costMs;
+    frameScales[frameCostNext] = (float)sceneWidth / viewWidth;
+    frameCostNext = (frameCostNext + 1) % FRAME_INTERVAL_HISTORY;
+    frameCostCount = std::min(frameCostCount + 1, FRAME_INTERVAL_HISTORY);
+
+    if (!useDynamicResolution || frameBudgetMs <= 0.0f) {
+        sceneScale = 1.0f;
+        drsCostFrames = 0;
+        return;
+    }
+    drsCosts[drsCostFrames++] = costMs;
+    if (drsCostFrames < DRS_WINDOW_FRAMES) {
+        return;
+    }
+
+    drsCostFrames = 0;
+    std::nth_element(drsCosts, drsCosts + DRS_WINDOW_FRAMES / 2, drsCosts + DRS_WINDOW_FRAMES);
+    float medianMs = drsCosts[DRS_WINDOW_FRAMES / 2];
+    if (medianMs > frameBudgetMs * DRS_LOWER_MARGIN) {
+        sceneScale = std::max(DRS_MIN_SCALE, sceneScale * sqrtf(frameBudgetMs / medianMs));
+    }
+    else if (medianMs < frameBudgetMs * DRS_RAISE_HEADROOM) {
+        sceneScale = std::min(1.0f, sceneScale + DRS_RAISE_STEP);
+    }
 }
 
 void display()
 {
+    // Timings of the previous frame (and the ticks since) first
+    collectProfileEvents();
+    PROFILE_SCOPE(PROFILE_FRAME);
+
+    // Swap in the next level once it is wanted and has been built. Until the
+    // first one is there, the menu or the build progress is all there is to draw.
+    if (levelRequested && nextLevel && nextLevel->jobs->finished()) {
+        startLevel();
+    }
+    if (currentLevel == 0) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawLoadingScreen();
+        drawHudText();
+        glutSwapBuffers();
+        glutPostRedisplay();
+        return;
+    }
+
+    // Pick up the newest simulation state and place the camera
+    updateFrameState();
+    auto frameStart = std::chrono::steady_clock::now();
+    beginFrameTimer();
+    bool scaled = beginScene();
+
     // Clear the color and depth buffers
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  //clears the color and the depth before every scene
 
@@ -162,41 +923,83 @@ void display()
 
     // Apply camera rotation
     glRotatef(playerLookUpDown, 1.0f, 0.0f, 0.0f);  //looking up and down
-    glRotatef(playerAngle, 0.0f, 1.0f, 0.0f);      //horizontal moving
+    glRotatef(cameraAngle, 0.0f, 1.0f, 0.0f);      //horizontal moving
 
     // Apply camera translation
-    glTranslatef(-playerX, -playerY, -playerZ);  //moves opp to the world view so that it looks person is moving
+    glTranslatef(-cameraX, -playerY, -cameraZ);  //moves opp to the world view so that it looks person is moving
 
     // Draw the maze
-    drawMaze();
+    frameDrawCalls = 0;
+    frameTriangles = 0;
+    if (useRaycaster) {
+        drawRaycastView();
+    }
+    else {
+        drawMaze();
+        drawAgents();
+        if (showHints) {
+            drawHintPath();
+        }
+    }
+    if (scaled) {
+        resolveScene();
+    }
 
-    // Draw HUD elements
-    if (showMinimap) {
-        drawMinimap();
+    // Draw HUD elements, or the congratulations message if finished. Its
+    // background covers the whole window, so nothing else would show anyway.
+    if (frameState.showCongratsMessage) {
+        drawCongratsMessage();
     }
+    else {
+        if (showMinimap) {
+            drawMinimap();
+        }
 
-    drawTimer();
-    drawInstructions();
+        drawTimer();
+        drawInstructions();
 
-    // Display congratulations message if finished
-    if (showCongratsMessage) {
-        drawCongratsMessage();
+        if (showStats) {
+            drawStats();
+        }
+        if (showProfiler) {
+            drawProfiler();
+        }
+    }
+
+    // All HUD text queued above goes out in one batch
+    drawHudText();
+    endFrameTimer();
+
+    double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    frameTimeMs = frameTimeMs == 0.0 ? frameMs : frameTimeMs * 0.95 + frameMs * 0.05;
+    if (!offscreenMode) {
+        updateSceneScale(std::max((float)frameMs, gpuFrameMs));
     }
 
-    // Swap buffers
-    glutSwapBuffers();
+    // Swap buffers and go straight on to the next frame (paced by the buffer swap).
+    // Offscreen frames are driven by runOffscreenBenchmark() instead.
+    if (!offscreenMode) {
+        PROFILE_SCOPE(PROFILE_SWAP_BUFFERS);
+        glutSwapBuffers();
+        glutPostRedisplay();
+    }
 }
 
 void reshape(int width, int height)
 {
     // Set viewport
     glViewport(0, 0, width, height);  //maps the 3d scene to the size of the window
+    viewWidth = width;
+    viewHeight = height;
+    viewAspect = (float)width / (float)(height > 0 ? height : 1);
 
     // Set perspective projection    (GL_projection where 3d scene is presented on the 2d screen)
     glMatrixMode(GL_PROJECTION);   //camera lens that how u see the world
     glLoadIdentity();
     //60- view angle  , w/h - aspect ratio , 0.1 - how close we can go and still is visible , 100f- means how far is something and still visible
-    gluPerspective(60.0f, (float)width / (float)height, 0.001f, 100.0f);
+    // The near plane stays inside the player's collision circle (PLAYER_RADIUS),
+    // so walls are never clipped, and far enough out to keep the depth precise
+    gluPerspective(60.0f, (float)width / (float)height, 0.05f, 100.0f);
 
     // Reset modelview matrix
     glMatrixMode(GL_MODELVIEW);//the objects and the camera position in the world.
@@ -207,8 +1010,22 @@ void keyboard(unsigned char key, int x, int y)
 {
     keyStates[key] = true;
 
-    // Exit on escape
+    // Exit on escape, with a summary of the frame pacing
     if (key == 27) {
+        printf("Frame interval p50 %.2f / p95 %.2f / p99 %.2f ms over the last %d frames, %llu ticks run, %llu missed\n",
+               frameIntervalPercentile(50.0f), frameIntervalPercentile(95.0f), frameIntervalPercentile(99.0f),
+               frameIntervalCount, (unsigned long long)frameState.tick, (unsigned long long)frameState.missedTicks);
+        stopSimulation();
+        if (recordingInput) {
+            finishRecording();
+            saveRecording(inputRecording, recordPath);
+        }
+        saveTrace();
+
+        // A level still building uses the worker pools, which go away on exit
+        if (nextLevel) {
+            nextLevel->jobs->wait();
+        }
         exit(0);
     }
 
@@ -217,9 +1034,78 @@ void keyboard(unsigned char key, int x, int y)
         showMinimap = !showMinimap;
     }
 
-    // Dismiss congratulations message with space
-    if (key == ' ' && showCongratsMessage) {
-        showCongratsMessage = false;
+    // Toggle render statistics with 'i'
+    if (key == 'i' || key == 'I') {
+        showStats = !showStats;
+    }
+
+    // Switch between the baked lighting and the lamp above the eye with 'l'
+    if ((key == 'l' || key == 'L') && mazeLighting.baked()) {
+        useBakedLighting = !useBakedLighting;
+        rebuildMazeMesh();
+        applyLighting();
+    }
+
+    // Switch between the baked mesh and the old per-cube renderer with 'b'
+    if (key == 'b' || key == 'B') {
+        useBakedMesh = !useBakedMesh;
+    }
+
+    // Toggle visibility culling with 'c' (always on when the maze was too big to bake)
+    if ((key == 'c' || key == 'C') && mazeMeshBaked) {
+        useCulling = !useCulling;
+    }
+
+    // Switch culling between the precomputed sets and per-frame rays with 'v'
+    if ((key == 'v' || key == 'V') && pvsLoaded) {
+        usePvs = !usePvs;
+    }
+
+    // Dynamic resolution on and off with 'd' (full resolution when off)
+    if ((key == 'd' || key == 'D') && frameBudgetMs > 0.0f) {
+        useDynamicResolution = !useDynamicResolution;
+    }
+
+    // Switch between the GL renderer and the CPU raycaster with 'r'
+    if (key == 'r' || key == 'R') {
+        useRaycaster = !useRaycaster;
+    }
+
+    // Per-stage frame timings with 'p' (recording stays on while tracing)
+    if (key == 'p' || key == 'P') {
+        showProfiler = !showProfiler;
+        profilerEnabled = showProfiler || !tracePath.empty();
+        profileFrameCount = 0;
+        profileOverlayAge = 0;
+    }
+
+    // Fog of war on the minimap with 'f'
+    if (key == 'f' || key == 'F') {
+        fogOfWar = !fogOfWar;
+        minimapDirty = true;
+    }
+
+    // Switch between the glyph atlas and per-character glutBitmapCharacter text with 't'
+    if (key == 't' || key == 'T') {
+        useBatchedText = !useBatchedText;
+    }
+
+    // Show the next steps towards the goal with 'h'
+    if (key == 'h' || key == 'H') {
+        showHints = !showHints;
+        hintCellX = -1;
+    }
+
+    // Difficulty menu before the first level
+    if (currentLevel == 0 && !nextLevel && key >= '0' + DIFFICULTY_EASY && key <= '0' + DIFFICULTY_HARD) {
+        k = key - '0';
+        difficultyChosen = true;
+        prepareLevel(1, mazeSizeForDifficulty(k), firstLevelSeed);
+    }
+
+    // Go on to the next level with space (it starts once built, usually at once)
+    if (key == ' ' && frameState.showCongratsMessage && nextLevel) {
+        levelRequested = true;
     }
 }
 
@@ -228,171 +1114,1296 @@ void keyboardUp(unsigned char key, int x, int y)
     keyStates[key] = false;
 }
 
-// Added for arrow keys
+// Movement control of an arrow key, -1 for other special keys
+static int arrowKeyControl(int key)
+{
+    switch (key) {
+    case GLUT_KEY_UP: return CONTROL_FORWARD;
+    case GLUT_KEY_DOWN: return CONTROL_BACKWARD;
+    case GLUT_KEY_LEFT: return CONTROL_TURN_LEFT;
+    case GLUT_KEY_RIGHT: return CONTROL_TURN_RIGHT;
+    default: return -1;
+    }
+}
+
+// Added for arrow keys - forwarded to the simulation thread
 void specialKeyboard(int key, int x, int y)
 {
-    specialKeyStates[key] = true;
+    int control = arrowKeyControl(key);
+    if (control >= 0 && !inputQueue.push({ (uint8_t)INPUT_CONTROL_DOWN, (uint8_t)control })) {
+        droppedInputs++;
+    }
 }
 
 // Added for arrow keys
 void specialKeyboardUp(int key, int x, int y)
 {
-    specialKeyStates[key] = false;
+    int control = arrowKeyControl(key);
+    if (control >= 0 && !inputQueue.push({ (uint8_t)INPUT_CONTROL_UP, (uint8_t)control })) {
+        droppedInputs++;
+    }
+}
+
+// Jobs that derive everything else of a level from its maze, after the jobs in after
+static void addLevelJobs(PreparedLevel& level, std::initializer_list<int> after)
+{
+    PreparedLevel* target = &level;
+    bool fog = fogOfWar;
+    bool lit = useBakedLighting;
+    int bake = level.jobs->add([target] {
+        if (target->size <= MAX_LIGHT_BAKE_SIZE) {
+            bakeLighting(target->grid, target->seed, target->lighting);
+        }
+    }, after);
+    level.jobs->add([target, lit] {
+        if (target->size <= MAX_BAKED_MAZE_SIZE) {
+            target->meshLit = lit && target->lighting.baked();
+            buildMazeMesh(target->grid, target->meshLit ? &target->lighting : nullptr, target->mesh);
+            target->meshBaked = true;
+        }
+    }, { bake });
+    level.jobs->add([target] {
+        if (target->size <= MAX_PREBUILT_DISTANCE_FIELD_SIZE) {
+            target->reachableCells = buildDistanceField(target->grid, target->solver, target->size, target->size);
+        }
+    }, after);
+    level.jobs->add([target, fog] {
+        target->minimapFog = fog;
+        rasterizeMinimap(target->grid, nullptr, fog, target->minimapScale, target->minimapWidth, target->minimapHeight,
+                         target->minimapPixels);
+    }, after);
+
+    // Potentially visible sets, cached on disk per maze
+    if (pvsRequested) {
+        level.jobs->add([target] {
+            char pvsPath[128];
+            snprintf(pvsPath, sizeof(pvsPath), "maze_pvs_%d_%u.bin", target->size, target->seed);
+            target->pvsLoaded = loadPvs(target->grid, target->seed, target->pvs, pvsPath);
+            if (!target->pvsLoaded) {
+                buildPvs(target->grid, target->pvs);
+                savePvs(target->grid, target->seed, target->pvs, pvsPath);
+                target->pvsLoaded = true;
+            }
+        }, after);
+    }
+}
+
+// Start building level number on a size x size maze from seed in the background
+void prepareLevel(int number, int size, unsigned int seed)
+{
+    nextLevel.reset(new PreparedLevel());
+    PreparedLevel& level = *nextLevel;
+    level.number = number;
+    level.size = size;
+    level.seed = seed;
+    level.generator = resolveGenerator(size, levelGenerator);
+    level.jobs.reset(new JobGraph(std::min(LEVEL_BUILD_THREADS, std::max(1u, std::thread::hardware_concurrency()))));
+
+    PreparedLevel* target = &level;
+    int generate = level.jobs->add([target] {
+        auto startTime = std::chrono::steady_clock::now();
+        generateMazeGrid(target->grid, target->size, target->seed, target->generator);
+        target->generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    });
+    addLevelJobs(level, { generate });
+    level.jobs->start();
+}
+
+// Level 1 from "--load FILE": the maze is already mapped, only the rest is built
+void prepareLoadedLevel()
+{
+    nextLevel.reset(new PreparedLevel());
+    PreparedLevel& level = *nextLevel;
+    level.number = 1;
+    level.size = MAZE_SIZE;
+    level.seed = mazeSeed;
+    level.generator = mazeGenerator;
+    level.grid = std::move(maze);
+    level.jobs.reset(new JobGraph(std::min(LEVEL_BUILD_THREADS, std::max(1u, std::thread::hardware_concurrency()))));
+    addLevelJobs(level, {});
+    level.jobs->start();
 }
 
-void timer(int value)
+// Swap the built level in and start playing it: no generation left to do, only
+// moves and the GPU uploads. The level after it starts building right away.
+void startLevel()
 {
-    // Process player movement if game not finished
-    if (!showCongratsMessage) {
-        processMovement();
+    nextLevel->jobs->wait();
+    std::unique_ptr<PreparedLevel> level = std::move(nextLevel);
+
+    // The simulation reads the maze - stop it for the swap. The recording only
+    // covers level 1, since a replay rebuilds that one maze.
+    stopSimulation();
+    if (recordingInput) {
+        finishRecording();
+        saveRecording(inputRecording, recordPath);
+    }
+
+    std::swap(maze, level->grid);
+    if (level->number > 1) {
+        closeMazeFile();
+    }
+    MAZE_SIZE = level->size;
+    mazeSeed = level->seed;
+    mazeGenerator = level->generator;
+    std::swap(solver, level->solver);
+
+    mazeLighting = std::move(level->lighting);
+    mazeMesh = std::move(level->mesh);
+    mazeMeshBaked = level->meshBaked;
+    if (level->meshLit != (useBakedLighting && mazeLighting.baked())) {
+        rebuildMazeMesh();      // 'L' was pressed while the level was building
+    }
+    else if (mazeMeshBaked) {
+        uploadMazeMesh(mazeMesh);
+    }
+    applyLighting();
+    pvs = std::move(level->pvs);
+    pvsLoaded = level->pvsLoaded;
+
+    // Nothing explored yet on the new maze
+    exploredCells.resize(maze.width(), maze.height(), true);
+    exploredWindowChunk = endlessWindowChunk;
+    exploredCellX = -1;
+    exploredMinX = 0;
+    exploredMaxX = -1;
+    if (level->minimapFog == fogOfWar) {
+        minimapScale = level->minimapScale;
+        minimapTextureWidth = level->minimapWidth;
+        minimapTextureHeight = level->minimapHeight;
+        minimapPixels.swap(level->minimapPixels);
+        uploadMinimapTexture();
+    }
+    else {
+        minimapDirty = true;
+    }
+    hintCellX = -1;
+    hintPath.clear();
+    hintStepsToGoal = SOLVER_UNREACHABLE;
+
+    if (level->generateMs > 0.0) {
+        double cellsPerSecond = (double)(MAZE_SIZE + 2) * (MAZE_SIZE + 2) / std::max(level->generateMs, 0.001) * 1000.0;
+        std::cout << "Level " << level->number << ": maze " << MAZE_SIZE << "x" << MAZE_SIZE << " (seed " << mazeSeed << ", "
+                  << (mazeGenerator == GENERATOR_TILED ? "tiled" : "dfs") << " generator) generated in " << level->generateMs
+                  << " ms (" << cellsPerSecond / 1e6 << " M cells/s), grid uses " << maze.memoryBytes() / 1024 << " KB" << std::endl;
+    }
+    if (level->reachableCells > 0) {
+        std::cout << "Distance field from (" << MAZE_SIZE << ", " << MAZE_SIZE << "): " << level->reachableCells
+                  << " reachable cells" << std::endl;
+    }
+    if (level->number == 1 && !saveMazePath.empty()) {
+        saveMazeFile(saveMazePath);
     }
 
-    // Check for game completion
-    if (!gameFinished && playerX > MAZE_SIZE - 1.5f && playerZ > MAZE_SIZE - 1.5f) {
-        gameFinished = true;
-        showCongratsMessage = true;
-        finalTime = time(NULL) - gameStartTime;
-        std::cout << "Maze completed! Time: " << finalTime << " seconds" << std::endl;
+    // Agents, placed from the maze seed
+    if (agentCount > 0) {
+        spawnAgents(agents, agentCount, AGENT_CHASER_FRACTION, mazeSeed);
+        publishAgentSnapshot(agents, 0);
+        std::cout << agents.count << " agents (" << agents.chasers << " chasers)" << std::endl;
     }
 
-    // Redraw the scene
-    glutPostRedisplay();
+    currentLevel = level->number;
+    levelRequested = false;
+    cameraX = cameraZ = 1.0f;
+    cameraAngle = 0.0f;
+
+    // Offscreen runs script the camera and build no further levels
+    if (offscreenMode) {
+        return;
+    }
 
-    // Register the next timer callback
-    glutTimerFunc(16, timer, 0);  //so we will update the timer every 16ms and then follow the same path , 16ms which leads to the 60fps which is smoother from the game persepective
+    resetRun();
+    frameState = GameSnapshot();
+    if (currentLevel == 1 && !recordPath.empty()) {
+        startRecording(MAZE_SIZE == mazeSizeForDifficulty(k) ? k : 0);
+    }
+    startSimulation();
+    loopLastTime = std::chrono::steady_clock::now();
+
+    // The next level gets the next difficulty, up to hard
+    int nextSize = MAZE_SIZE;
+    if (difficultyChosen && k < DIFFICULTY_HARD && MAZE_SIZE == mazeSizeForDifficulty(k)) {
+        k++;
+        nextSize = mazeSizeForDifficulty(k);
+    }
+    prepareLevel(currentLevel + 1, nextSize, firstLevelSeed + (unsigned int)currentLevel);
 }
 
-void processMovement()
+// Called once per rendered frame: take the newest simulation snapshot, set the
+// camera between its last two ticks and do the render-side bookkeeping
+void updateFrameState()
 {
-    // Calculate movement vectors based on player orientation
-    //shows in which direction the player is facing
-    float dx = sin(playerAngle * M_PI / 180.0f);    //left, right
-    float dz = -cos(playerAngle * M_PI / 180.0f);   //forward and backwork
+    PROFILE_SCOPE(PROFILE_UPDATE_FRAME_STATE);
+
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - loopLastTime).count();
+    loopLastTime = now;
+
+    frameIntervals[frameIntervalNext] = (float)(elapsed * 1000.0);
+    frameIntervalNext = (frameIntervalNext + 1) % FRAME_INTERVAL_HISTORY;
+    frameIntervalCount = std::min(frameIntervalCount + 1, FRAME_INTERVAL_HISTORY);
+
+    // Offscreen runs place the camera and fill in frameState themselves
+    if (!offscreenMode) {
+        bool wasFinished = frameState.gameFinished;
+        frameState = gameSnapshots.read();
+        if (frameState.gameFinished && !wasFinished) {
+            printf("Maze completed! Time: %.3f seconds\n", frameState.finalTimeMs / 1000.0);
+        }
 
-    float newX = playerX;
-    float newZ = playerZ;
+        // A snapshot taken before the last window slide is still in the old window's rows
+        float rebaseZ = (float)((frameState.windowChunk - endlessWindowChunk) * ENDLESS_CHUNK_ROWS);
+        frameState.playerZ += rebaseZ;
+        frameState.prevPlayerZ += rebaseZ;
+
+        // Interpolate the camera, taking the short way round for the angle. The
+        // newest tick is shown once a whole tick has passed since it was due.
+        float alpha = (float)std::min(1.0, std::max(0.0, std::chrono::duration<double>(now - frameState.tickTime).count() / tickSeconds));
+        float turn = frameState.playerAngle - frameState.prevPlayerAngle;
+        if (turn > 180.0f) turn -= 360.0f;
+        if (turn < -180.0f) turn += 360.0f;
+        cameraX = frameState.prevPlayerX + (frameState.playerX - frameState.prevPlayerX) * alpha;
+        cameraZ = frameState.prevPlayerZ + (frameState.playerZ - frameState.prevPlayerZ) * alpha;
+        cameraAngle = fmodf(frameState.prevPlayerAngle + turn * alpha + 360.0f, 360.0f);
+    }
+
+    // Slide the endless window along and remember how far the player got. The
+    // simulation reads the maze for collisions, so it is held while the rows
+    // are rewritten, and its positions are rebased with them.
+    if (endlessMode) {
+        int playerChunk = (int)floor(frameState.playerZ + 0.5f) / ENDLESS_CHUNK_ROWS;
+        if (playerChunk < 2 || playerChunk >= ENDLESS_WINDOW_CHUNKS - 2) {
+            pauseSimulation();
+            int64_t windowBefore = endlessWindowChunk;
+            updateEndlessWindow(false);
+            float shiftZ = (float)((endlessWindowChunk - windowBefore) * ENDLESS_CHUNK_ROWS);
+            prevPlayerZ -= shiftZ;
+            resumeSimulation();
+
+            cameraZ -= shiftZ;
+            frameState.playerZ -= shiftZ;
+            frameState.prevPlayerZ -= shiftZ;
+        }
+        endlessFurthestRow = std::max(endlessFurthestRow, endlessWindowChunk * ENDLESS_CHUNK_ROWS + (int64_t)frameState.playerZ);
+    }
 
-    // Process movement keys (Arrow keys instead of WASD)
-    if (specialKeyStates[GLUT_KEY_UP]) {    //up key is there which moves forward
-        newX += dx * cameraSpeed;
-        newZ += dz * cameraSpeed;
+    updateExploredCells();
+    if (showHints) {
+        updateHints();
     }
-    if (specialKeyStates[GLUT_KEY_DOWN]) {       //down arrow moves backward
-        newX -= dx * cameraSpeed;
-        newZ -= dz * cameraSpeed;
+}
+
+// Percentile (0-100) of the recent frame intervals in ms
+float frameIntervalPercentile(float percentile)
+{
+    if (frameIntervalCount == 0) {
+        return 0.0f;
     }
+    float sorted[FRAME_INTERVAL_HISTORY];
+    std::copy(frameIntervals, frameIntervals + frameIntervalCount, sorted);
+    std::sort(sorted, sorted + frameIntervalCount);
+    int index = std::min(frameIntervalCount - 1, (int)(percentile / 100.0f * frameIntervalCount));
+    return sorted[index];
+}
 
-    // Left and Right arrow keys for rotation
-    if (specialKeyStates[GLUT_KEY_LEFT]) {      //changes the camera angle to left
-        playerAngle -= rotationSpeed;
-        if (playerAngle < 0.0f) playerAngle += 360.0f;
+// Drain the profiler rings into the per-frame history (and the trace when one
+// is being recorded). Called once per frame, so everything drained belongs to
+// the previous frame or the ticks that ran during it.
+void collectProfileEvents()
+{
+    uint64_t* stageNs = profileStageNs[profileFrameNext];
+    uint32_t* stageCalls = profileStageCalls[profileFrameNext];
+    std::fill(stageNs, stageNs + PROFILE_STAGE_COUNT, 0);
+    std::fill(stageCalls, stageCalls + PROFILE_STAGE_COUNT, 0);
+
+    ProfileEvent event;
+    bool drained = false;
+    for (ProfileRing& ring : profileRings) {
+        while (ring.pop(event)) {
+            stageNs[event.stage] += event.durationNs;
+            stageCalls[event.stage]++;
+            if (!tracePath.empty() && traceEvents.size() < PROFILE_TRACE_MAX_EVENTS) {
+                traceEvents.push_back(event);
+            }
+            drained = true;
+        }
     }
-    if (specialKeyStates[GLUT_KEY_RIGHT]) {    //camera angle to right
-        playerAngle += rotationSpeed;
-        if (playerAngle >= 360.0f) playerAngle -= 360.0f;
+    if (drained) {
+        profileFrameNext = (profileFrameNext + 1) % PROFILE_HISTORY_FRAMES;
+        profileFrameCount = std::min(profileFrameCount + 1, PROFILE_HISTORY_FRAMES);
     }
+}
 
-    // Check for collisions before updating position
-    //check for the collision , if there is then player y will change its position on the xz plane
-    if (!checkCollision(newX, playerY, newZ)) {
-        playerX = newX;
-        playerZ = newZ;
+// Write the recorded trace ("--trace FILE"), events in start order
+void saveTrace()
+{
+    if (tracePath.empty()) {
+        return;
+    }
+    collectProfileEvents();
+    uint64_t dropped = 0;
+    for (ProfileRing& ring : profileRings) {
+        dropped += ring.dropped.load(std::memory_order_relaxed);
     }
+    std::stable_sort(traceEvents.begin(), traceEvents.end(),
+                     [](const ProfileEvent& a, const ProfileEvent& b) { return a.startNs < b.startNs; });
+    writeChromeTrace(traceEvents, dropped, tracePath);
 }
 
-void generateMaze()
+// "--replay FILE": rebuild the recorded maze, run the session again headless
+// and compare how it ends. Returns the process exit code.
+int runReplay(const std::string& path)
 {
-    // Initialize maze with all walls
-    maze.resize(MAZE_SIZE + 2, std::vector<int>(MAZE_SIZE + 2, 1));
+    InputRecording recording;
+    if (!loadRecording(path, recording)) {
+        return 1;
+    }
 
-    // Create a path through the maze using randomized DFS with increased complexity
-    std::vector<std::pair<int, int>> stack;
-    std::random_device rd;
-    std::mt19937 rng(rd());
+    generateMaze(recording.mazeSize, recording.seed, recording.generator);
+    if (maze.checksum() != recording.mazeChecksum) {
+        std::cout << "The " << recording.mazeSize << "x" << recording.mazeSize << " maze with seed " << recording.seed
+                  << " doesn't match the recorded one" << std::endl;
+        return 1;
+    }
 
-    // Start at (1,1) (accounting for boundary walls)
-    maze[1][1] = 0;
-    stack.push_back({ 1, 1 });
+    ReplayResult result = replayRecording(recording);
+    printf("Replayed %llu ticks (%llu input events) in %.2f ms, %.1f M ticks/s\n", (unsigned long long)result.ticks,
+           (unsigned long long)recording.eventCount, result.elapsedMs, result.ticks / std::max(result.elapsedMs, 1e-6) / 1000.0);
+    printf("  final state (%.4f, %.4f, %.2f deg) %s\n", result.finalX, result.finalZ, result.finalAngle,
+           result.stateMatches ? "matches" : "DIFFERS from the recording");
+    if (recording.finishTick != 0 || result.finishTick != 0) {
+        printf("  goal reached on tick %llu (%.3f s), recorded %llu: %s\n", (unsigned long long)result.finishTick,
+               result.finishTick / (double)recording.tickRate, (unsigned long long)recording.finishTick,
+               result.finishMatches ? "matches" : "DIFFERS");
+    }
+    return result.stateMatches && result.finishMatches ? 0 : 1;
+}
 
-    // Define direction vectors
-    const int dx[] = { 0, 1, 0, -1 };
-    const int dy[] = { -1, 0, 1, 0 };
+// EGL context without a window (surfaceless where Mesa offers it, so a software
+// rasterizer works on machines with no display) rendering into a framebuffer object
+bool createOffscreenContext(int width, int height)
+{
+#ifdef MAZE_OFFSCREEN
+    EGLDisplay display = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+#endif
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major = 0;
+    EGLint minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API)) {
+        std::cout << "No EGL display for offscreen rendering" << std::endl;
+        return false;
+    }
 
-    while (!stack.empty()) {
-        int x = stack.back().first;
-        int y = stack.back().second;
+    // No surface is needed, so any desktop GL config will do (or none at all)
+    const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = (EGLConfig)0;
+    EGLint configCount = 0;
+    eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+    EGLContext context = eglCreateContext(display, configCount > 0 ? config : (EGLConfig)0, EGL_NO_CONTEXT, NULL);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cout << "Could not create an offscreen OpenGL context (EGL 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+        return false;
+    }
 
-        // Find unvisited neighbors
-        std::vector<int> neighbors;
-        for (int i = 0; i < 4; i++) {
-            int nx = x + 2 * dx[i];
-            int ny = y + 2 * dy[i];
+    GLuint colorBuffer = 0;
+    GLuint depthBuffer = 0;
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glGenFramebuffers(1, &offscreenFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreenFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Offscreen framebuffer is incomplete" << std::endl;
+        return false;
+    }
 
-            if (nx >= 1 && nx <= MAZE_SIZE && ny >= 1 && ny <= MAZE_SIZE && maze[nx][ny] == 1) {
-                neighbors.push_back(i);
-            }
-        }
+    std::cout << "Offscreen " << width << "x" << height << " on " << glGetString(GL_RENDERER) << " ("
+              << glGetString(GL_VERSION) << ", EGL " << major << "." << minor << ")" << std::endl;
+    return true;
+#else
+    (void)width;
+    (void)height;
+    std::cout << "Built without offscreen rendering, rebuild with -DMAZE_OFFSCREEN and -lEGL" << std::endl;
+    return false;
+#endif
+}
+
+// "--offscreen N": run display() for N frames with the camera walking the
+// solution at a steady pace, looking a cell ahead, and report frame times.
+// Frames don't depend on the clock (the HUD timer counts frames at the nominal
+// rate), so dumps from the same maze and seed can be compared image to image.
+int runOffscreenBenchmark()
+{
+    reshape(WINDOW_WIDTH, WINDOW_HEIGHT);
 
-        // If no unvisited neighbors, backtrack
-        if (neighbors.empty()) {
-            stack.pop_back();
+    std::vector<int> path;
+    if (!findPath(1, 1, MAZE_SIZE, MAZE_SIZE, path) || path.size() < 2) {
+        std::cout << "No path to the goal to fly the camera along" << std::endl;
+        return 1;
+    }
+    int width = maze.width();
+    float step = OFFSCREEN_WALK_SPEED / OFFSCREEN_FRAME_RATE;
+    float pathLength = (float)(path.size() - 1);
+    int frames = offscreenFrames > 0 ? offscreenFrames : (int)ceilf(pathLength / step) + 1;
+
+    // Point on the path (in cells from the start, clamped to the goal)
+    auto pathPoint = [&](float distance, float& x, float& z) {
+        distance = std::min(distance, pathLength);
+        size_t s = std::min((size_t)distance, path.size() - 2);
+        float t = distance - (float)s;
+        x = (path[s] % width) * (1.0f - t) + (path[s + 1] % width) * t;
+        z = (path[s] / width) * (1.0f - t) + (path[s + 1] / width) * t;
+    };
+
+    std::vector<double> frameMs;
+    frameMs.reserve(frames);
+    long long totalTriangles = 0;
+    long long totalDrawCalls = 0;
+    int framesDumped = 0;
+    double scaleSum = 0.0;
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (int frame = 0; frame < frames; frame++) {
+        // Walk the path, starting over at the goal
+        float distance = fmodf(frame * step, pathLength + 1.0f);
+        float aheadX, aheadZ;
+        pathPoint(distance, cameraX, cameraZ);
+        pathPoint(distance + 1.0f, aheadX, aheadZ);
+        if (aheadX != cameraX || aheadZ != cameraZ) {
+            cameraAngle = atan2f(aheadX - cameraX, -(aheadZ - cameraZ)) * 180.0f / M_PI;
+            cameraAngle = fmodf(cameraAngle + 360.0f, 360.0f);
+        }
+        playerX = cameraX;
+        playerZ = cameraZ;
+        playerAngle = cameraAngle;
+        frameState.playerX = frameState.prevPlayerX = cameraX;
+        frameState.playerZ = frameState.prevPlayerZ = cameraZ;
+        frameState.playerAngle = frameState.prevPlayerAngle = cameraAngle;
+        frameState.tick = (uint64_t)(frame * tickRate / OFFSCREEN_FRAME_RATE);
+        if (agents.count > 0) {
+            updateAgents(agents, 1.0f / OFFSCREEN_FRAME_RATE, cameraX, cameraZ);
+            publishAgentSnapshot(agents, frameState.tick);
         }
-        else {
-            // Choose a random neighbor
-            std::shuffle(neighbors.begin(), neighbors.end(), rng);
-            int dir = neighbors[0];
-
-            // Carve a path
-            int nx = x + 2 * dx[dir];
-            int ny = y + 2 * dy[dir];
-            maze[x + dx[dir]][y + dy[dir]] = 0; // Remove wall between cells
-            maze[nx][ny] = 0; // Mark new cell as visited
-
-            stack.push_back({ nx, ny });
-        }
-    }
-
-    // Set entrance and exit
-    maze[1][1] = 0;
-    maze[MAZE_SIZE][MAZE_SIZE] = 0;
-
-    // Add some additional random openings to increase complexity (30% chance of removing a wall)
-    for (int i = 2; i < MAZE_SIZE; i++) {
-        for (int j = 2; j < MAZE_SIZE; j++) {
-            if (maze[i][j] == 1 && (rng() % 100) < 30) {
-                // Check if removing this wall would create a valid path
-                int pathCount = 0;
-                for (int k = 0; k < 4; k++) {
-                    int nx = i + dx[k];
-                    int ny = j + dy[k];
-                    if (nx >= 1 && nx <= MAZE_SIZE && ny >= 1 && ny <= MAZE_SIZE && maze[nx][ny] == 0) {
-                        pathCount++;
-                    }
-                }
 
-                // Only remove if it connects at least 2 existing paths
-                if (pathCount >= 2) {
-                    maze[i][j] = 0;
-                }
+        // glFinish so the time covers the rasterizer too, not just the submission
+        auto frameStart = std::chrono::steady_clock::now();
+        display();
+        glFinish();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+        scaleSum += (float)sceneWidth / viewWidth;
+        updateSceneScale(std::max((float)frameMs.back(), gpuFrameMs));
+        totalTriangles += frameTriangles;
+        totalDrawCalls += frameDrawCalls;
+
+        if (!offscreenDumpDir.empty()) {
+            char framePath[64];
+            snprintf(framePath, sizeof(framePath), "/frame_%05d.ppm", frame);
+            if (writeFramePpm(offscreenDumpDir + framePath, WINDOW_WIDTH, WINDOW_HEIGHT)) {
+                framesDumped++;
             }
         }
     }
+
+    double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    double renderMs = 0.0;
+    for (double ms : frameMs) {
+        renderMs += ms;
+    }
+    std::sort(frameMs.begin(), frameMs.end());
+    auto percentile = [&](double p) { return frameMs[std::min(frameMs.size() - 1, (size_t)(p / 100.0 * frameMs.size()))]; };
+
+    printf("Offscreen: %d frames along a %d-cell path in %.1f ms, %.1f fps (render only)\n", frames, (int)path.size(),
+           totalMs, frames * 1000.0 / renderMs);
+    printf("Frame time p50 %.2f / p95 %.2f / p99 %.2f / max %.2f ms, %lld triangles and %lld draw calls per frame\n",
+           percentile(50.0), percentile(95.0), percentile(99.0), frameMs.back(), totalTriangles / frames, totalDrawCalls / frames);
+    if (frameBudgetMs > 0.0f) {
+        printf("Dynamic resolution: %.1f ms budget, %.0f%% scale on average, %.0f%% at the end\n", frameBudgetMs,
+               100.0 * scaleSum / frames, 100.0f * sceneScale);
+    }
+    if (!offscreenDumpDir.empty()) {
+        printf("%d frames written to %s\n", framesDumped, offscreenDumpDir.c_str());
+    }
+    saveTrace();
+    return framesDumped == (offscreenDumpDir.empty() ? 0 : frames) ? 0 : 1;
 }
 
-void drawMaze()
+// Read the current framebuffer back and write it as a binary PPM, top row first
+bool writeFramePpm(const std::string& path, int width, int height)
 {
-    // Draw each cell in the maze
-    for (int i = 0; i < MAZE_SIZE + 2; i++) {
-        for (int j = 0; j < MAZE_SIZE + 2; j++) {
-            if (maze[i][j] == 1) { // Wall
-                // All walls are the same color now (including boundary walls)
+    std::vector<uint8_t> pixels((size_t)width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "Could not write " << path << std::endl;
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; y--) {
+        fwrite(&pixels[(size_t)y * width * 3], 1, (size_t)width * 3, file);
+    }
+    return fclose(file) == 0;
+}
+
+// Recompute the hint whenever the player enters another cell. A fixed maze
+// walks the distance field to the goal (built on first use); the endless maze
+// has no goal, so A* heads for the far end of the current window instead.
+void updateHints()
+{
+    int cellX = (int)floor(cameraX + 0.5f);
+    int cellZ = (int)floor(cameraZ + 0.5f);
+    if (cellX == hintCellX && cellZ == hintCellZ && endlessWindowChunk == hintWindowChunk) {
+        return;
+    }
+    hintCellX = cellX;
+    hintCellZ = cellZ;
+    hintWindowChunk = endlessWindowChunk;
+
+    if (endlessMode) {
+        int targetZ = maze.height() - 2;
+        int targetX = 1;
+        while (targetX < maze.width() - 1 && maze.isWall(targetX, targetZ)) {
+            targetX++;
+        }
+        findPath(cellX, cellZ, targetX, targetZ, hintPath);
+        hintStepsToGoal = SOLVER_UNREACHABLE;
+    }
+    else {
+        if (solver.goalX != MAZE_SIZE || solver.goalZ != MAZE_SIZE || solver.distance.empty()) {
+            auto startTime = std::chrono::steady_clock::now();
+            size_t reachable = buildDistanceField(MAZE_SIZE, MAZE_SIZE);
+            double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            std::cout << "Distance field from (" << MAZE_SIZE << ", " << MAZE_SIZE << ") built in " << elapsedMs << " ms, "
+                      << reachable << " reachable cells" << std::endl;
+        }
+        followDistanceField(cellX, cellZ, HINT_STEPS, hintPath);
+        hintStepsToGoal = hintPath.empty() ? SOLVER_UNREACHABLE : solver.distance[(size_t)cellZ * maze.width() + cellX];
+    }
+
+    if (hintPath.size() > (size_t)HINT_STEPS + 1) {
+        hintPath.resize(HINT_STEPS + 1);
+    }
+}
+
+// Append one quad (two triangles) to the mesh. Corners are given counter-clockwise
+// when looking at the face from the side the normal points to.
+static void addQuad(MazeMesh& mesh, const float corners[4][3], float nx, float ny, float nz,
+                    float r, float g, float b)
+{
+    unsigned int base = (unsigned int)mesh.vertices.size();
+    for (int c = 0; c < 4; c++) {
+        mesh.vertices.push_back({ corners[c][0], corners[c][1], corners[c][2], nx, ny, nz, r, g, b });
+    }
+    const unsigned int order[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int k = 0; k < 6; k++) {
+        mesh.indices.push_back(base + order[k]);
+    }
+}
+
+// addQuad() for a face of open cell (i, j), with the colour of every corner
+// lit by the baked light at that corner of the cell (lighting may be null)
+static void addLitQuad(MazeMesh& mesh, const MazeLighting* lighting, int i, int j, const float corners[4][3],
+                       float nx, float ny, float nz, float r, float g, float b)
+{
+    if (!lighting) {
+        addQuad(mesh, corners, nx, ny, nz, r, g, b);
+        return;
+    }
+
+    unsigned int base = (unsigned int)mesh.vertices.size();
+    for (int c = 0; c < 4; c++) {
+        uint32_t light = lighting->at(i, j, corners[c][0] > i, corners[c][2] > j, corners[c][1] > 0.5f);
+        const float scale = 1.0f / LIGHT_ONE;
+        mesh.vertices.push_back({ corners[c][0], corners[c][1], corners[c][2], nx, ny, nz,
+                                  r * (light & 0xFF) * scale, g * (light >> 8 & 0xFF) * scale, b * (light >> 16 & 0xFF) * scale });
+    }
+    const unsigned int order[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int k = 0; k < 6; k++) {
+        mesh.indices.push_back(base + order[k]);
+    }
+}
+
+// Merge open cells into the largest rectangles we can find (greedy meshing) and
+// emit one horizontal quad per rectangle at height y
+static void addMergedPlane(MazeMesh& mesh, const MazeGrid& grid, float y, float ny, float r, float g, float b)
+{
+    int size = grid.width();
+    std::vector<char> used(size * size, 0);
+
+    for (int j = 0; j < size; j++) {
+        for (int i = 0; i < size; i++) {
+            if (grid.isWall(i, j) || used[j * size + i]) {
+                continue;
+            }
+
+            // Grow the run along x
+            int w = 1;
+            while (i + w < size && !grid.isWall(i + w, j) && !used[j * size + i + w]) {
+                w++;
+            }
+
+            // Grow the run along z while the whole row segment is still open
+            int h = 1;
+            while (j + h < size) {
+                bool rowOpen = true;
+                for (int t = 0; t < w; t++) {
+                    if (grid.isWall(i + t, j + h) || used[(j + h) * size + i + t]) {
+                        rowOpen = false;
+                        break;
+                    }
+                }
+                if (!rowOpen) {
+                    break;
+                }
+                h++;
+            }
+
+            for (int dz = 0; dz < h; dz++) {
+                for (int dx = 0; dx < w; dx++) {
+                    used[(j + dz) * size + i + dx] = 1;
+                }
+            }
+
+            // Cells are centred on integer coordinates, so cell i covers [i-0.5, i+0.5]
+            float x0 = i - 0.5f, x1 = i + w - 0.5f;
+            float z0 = j - 0.5f, z1 = j + h - 0.5f;
+            if (ny > 0.0f) {
+                const float corners[4][3] = { { x0, y, z1 }, { x1, y, z1 }, { x1, y, z0 }, { x0, y, z0 } };
+                addQuad(mesh, corners, 0.0f, ny, 0.0f, r, g, b);
+            }
+            else {
+                const float corners[4][3] = { { x0, y, z0 }, { x1, y, z0 }, { x1, y, z1 }, { x0, y, z1 } };
+                addQuad(mesh, corners, 0.0f, ny, 0.0f, r, g, b);
+            }
+        }
+    }
+}
+
+// Emit the wall faces around open cell (i, j). Only the sides of wall cells that
+// look into an open cell are ever visible, so faces between two walls and the
+// outside of the border are never generated.
+static void addCellWalls(MazeMesh& mesh, const MazeGrid& grid, const MazeLighting* lighting, int i, int j)
+{
+    int width = grid.width();
+    int height = grid.height();
+    float x0 = i - 0.5f, x1 = i + 0.5f;
+    float z0 = j - 0.5f, z1 = j + 0.5f;
+
+    if (i > 0 && grid.isWall(i - 1, j)) {     // wall on the -x side, face points +x
+        const float corners[4][3] = { { x0, 0.0f, z1 }, { x0, 0.0f, z0 }, { x0, 1.0f, z0 }, { x0, 1.0f, z1 } };
+        addLitQuad(mesh, lighting, i, j, corners, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f, 0.7f);
+        mesh.wallQuads++;
+    }
+    if (i < width - 1 && grid.isWall(i + 1, j)) {  // wall on the +x side, face points -x
+        const float corners[4][3] = { { x1, 0.0f, z0 }, { x1, 0.0f, z1 }, { x1, 1.0f, z1 }, { x1, 1.0f, z0 } };
+        addLitQuad(mesh, lighting, i, j, corners, -1.0f, 0.0f, 0.0f, 0.5f, 0.5f, 0.7f);
+        mesh.wallQuads++;
+    }
+    if (j > 0 && grid.isWall(i, j - 1)) {     // wall on the -z side, face points +z
+        const float corners[4][3] = { { x0, 0.0f, z0 }, { x1, 0.0f, z0 }, { x1, 1.0f, z0 }, { x0, 1.0f, z0 } };
+        addLitQuad(mesh, lighting, i, j, corners, 0.0f, 0.0f, 1.0f, 0.5f, 0.5f, 0.7f);
+        mesh.wallQuads++;
+    }
+    if (j < height - 1 && grid.isWall(i, j + 1)) {  // wall on the +z side, face points -z
+        const float corners[4][3] = { { x1, 0.0f, z1 }, { x0, 0.0f, z1 }, { x0, 1.0f, z1 }, { x1, 1.0f, z1 } };
+        addLitQuad(mesh, lighting, i, j, corners, 0.0f, 0.0f, -1.0f, 0.5f, 0.5f, 0.7f);
+        mesh.wallQuads++;
+    }
+}
+
+// Floor and ceiling of a single open cell (used by the culled path, which can't
+// merge, and with baked lighting, which has colours at every cell corner)
+static void addCellFloorAndCeiling(MazeMesh& mesh, const MazeLighting* lighting, int i, int j)
+{
+    float x0 = i - 0.5f, x1 = i + 0.5f;
+    float z0 = j - 0.5f, z1 = j + 0.5f;
+
+    const float floorCorners[4][3] = { { x0, 0.005f, z1 }, { x1, 0.005f, z1 }, { x1, 0.005f, z0 }, { x0, 0.005f, z0 } };
+    addLitQuad(mesh, lighting, i, j, floorCorners, 0.0f, 1.0f, 0.0f, 0.3f, 0.3f, 0.3f);
+    mesh.floorQuads++;
+
+    const float ceilingCorners[4][3] = { { x0, 0.995f, z0 }, { x1, 0.995f, z0 }, { x1, 0.995f, z1 }, { x0, 0.995f, z1 } };
+    addLitQuad(mesh, lighting, i, j, ceilingCorners, 0.0f, -1.0f, 0.0f, 0.2f, 0.2f, 0.2f);
+    mesh.ceilingQuads++;
+}
+
+// The whole maze as one mesh. Without lighting the floor and ceiling are merged
+// into big rectangles; with it every cell keeps its own, to carry its light.
+void buildMazeMesh(const MazeGrid& grid, const MazeLighting* lighting, MazeMesh& mesh)
+{
+    mesh = MazeMesh();
+    int size = grid.width();
+
+    // Wall faces, grouped by the open cell they face
+    for (int j = 0; j < size; j++) {
+        for (int i = 0; i < size; i++) {
+            if (!grid.isWall(i, j)) {
+                addCellWalls(mesh, grid, lighting, i, j);
+            }
+        }
+    }
+
+    if (lighting) {
+        for (int j = 0; j < size; j++) {
+            for (int i = 0; i < size; i++) {
+                if (!grid.isWall(i, j)) {
+                    addCellFloorAndCeiling(mesh, lighting, i, j);
+                }
+            }
+        }
+        std::cout << "Maze mesh: " << mesh.wallQuads << " wall faces, " << mesh.floorQuads << " floor and ceiling cells, "
+                  << lighting->lanternX.size() << " lanterns baked in (" << mesh.indices.size() / 3 << " triangles)" << std::endl;
+        return;
+    }
+
+    // Floor and ceiling - same heights as the top/bottom of the old flattened cubes
+    size_t before = mesh.indices.size();
+    addMergedPlane(mesh, grid, 0.005f, 1.0f, 0.3f, 0.3f, 0.3f);
+    mesh.floorQuads = (int)((mesh.indices.size() - before) / 6);
+
+    before = mesh.indices.size();
+    addMergedPlane(mesh, grid, 0.995f, -1.0f, 0.2f, 0.2f, 0.2f);
+    mesh.ceilingQuads = (int)((mesh.indices.size() - before) / 6);
+
+    std::cout << "Maze mesh: " << mesh.wallQuads << " wall faces, " << mesh.floorQuads
+              << " floor quads, " << mesh.ceilingQuads << " ceiling quads ("
+              << mesh.indices.size() / 3 << " triangles)" << std::endl;
+}
+
+void uploadMazeMesh(const MazeMesh& mesh)
+{
+    if (mazeVertexBuffer == 0) {
+        glGenBuffers(1, &mazeVertexBuffer);
+        glGenBuffers(1, &mazeIndexBuffer);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, mazeVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(MazeVertex), mesh.vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mazeIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// Walk one ray through the grid (DDA) from (posX, posZ) in half-cell-shifted
+// coordinates, calling visit(x, z) for every open cell it passes until it hits
+// a wall or reaches the far plane
+template <typename Visit>
+static void traceGridRay(const MazeGrid& grid, float posX, float posZ, float dirX, float dirZ, Visit visit)
+{
+    int width = grid.width();
+    int height = grid.height();
+    int cellX = (int)floor(posX);
+    int cellZ = (int)floor(posZ);
+
+    int stepX = dirX < 0.0f ? -1 : 1;
+    int stepZ = dirZ < 0.0f ? -1 : 1;
+    float deltaX = dirX != 0.0f ? fabsf(1.0f / dirX) : 1e30f;
+    float deltaZ = dirZ != 0.0f ? fabsf(1.0f / dirZ) : 1e30f;
+    float sideX = (dirX < 0.0f ? posX - cellX : cellX + 1.0f - posX) * deltaX;
+    float sideZ = (dirZ < 0.0f ? posZ - cellZ : cellZ + 1.0f - posZ) * deltaZ;
+
+    float travelled = 0.0f;
+    while (travelled <= VIEW_DISTANCE) {
+        if (cellX < 0 || cellX >= width || cellZ < 0 || cellZ >= height || grid.isWall(cellX, cellZ)) {
+            break;
+        }
+
+        visit(cellX, cellZ);
+
+        if (sideX < sideZ) {
+            travelled = sideX;
+            sideX += deltaX;
+            cellX += stepX;
+        }
+        else {
+            travelled = sideZ;
+            sideZ += deltaZ;
+            cellZ += stepZ;
+        }
+    }
+}
+
+void collectVisibleCells()
+{
+    int window = 2 * VISIBILITY_RADIUS + 1;
+    if (visibleStamp.empty()) {
+        visibleStamp.assign(window * window, 0);
+    }
+
+    // A new stamp value clears the window without touching it
+    visibilityFrame++;
+    visibleCells.clear();
+
+    // Horizontal half-angle from the 60 degree vertical FOV, plus a little slack
+    float halfFov = atanf(tanf(30.0f * M_PI / 180.0f) * viewAspect) + 2.0f * M_PI / 180.0f;
+    float baseAngle = cameraAngle * M_PI / 180.0f;
+
+    // Cell i covers [i-0.5, i+0.5], so shift by half a cell to get plain floor() cells
+    int width = maze.width();
+    int height = maze.height();
+    float posX = cameraX + 0.5f;
+    float posZ = cameraZ + 0.5f;
+    int originX = (int)floor(posX) - VISIBILITY_RADIUS;
+    int originZ = (int)floor(posZ) - VISIBILITY_RADIUS;
+
+    for (int r = 0; r < VISIBILITY_RAYS; r++) {
+        float angle = baseAngle - halfFov + 2.0f * halfFov * (r + 0.5f) / VISIBILITY_RAYS;
+        traceGridRay(maze, posX, posZ, sin(angle), -cos(angle), [&](int x, int z) {
+            uint32_t& stamp = visibleStamp[(z - originZ) * window + (x - originX)];
+            if (stamp != visibilityFrame) {
+                stamp = visibilityFrame;
+                visibleCells.push_back(z * width + x);
+            }
+        });
+    }
+
+    // The cells right around the camera straddle the near plane, always keep them
+    int cellX = (int)floor(cameraX + 0.5f);
+    int cellZ = (int)floor(cameraZ + 0.5f);
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            int x = cellX + dx;
+            int z = cellZ + dz;
+            if (x < 0 || x >= width || z < 0 || z >= height || maze.isWall(x, z)) {
+                continue;
+            }
+            uint32_t& stamp = visibleStamp[(dz + VISIBILITY_RADIUS) * window + (dx + VISIBILITY_RADIUS)];
+            if (stamp != visibilityFrame) {
+                stamp = visibilityFrame;
+                visibleCells.push_back(z * width + x);
+            }
+        }
+    }
+}
+
+// True when every cell of inner is also in outer and outer holds at most
+// maxGrowth times as many cells. Both run lists are sorted.
+static bool pvsRunsCover(const PvsRun* outer, uint32_t outerCount, const PvsRun* inner, uint32_t innerCount, float maxGrowth)
+{
+    uint64_t outerCells = 0;
+    uint64_t innerCells = 0;
+    for (uint32_t r = 0; r < outerCount; r++) {
+        outerCells += outer[r].length;
+    }
+    for (uint32_t r = 0; r < innerCount; r++) {
+        innerCells += inner[r].length;
+    }
+    if (outerCells > innerCells * maxGrowth) {
+        return false;
+    }
+
+    // Every inner run has to sit inside a single outer run, since runs never touch
+    uint32_t o = 0;
+    for (uint32_t r = 0; r < innerCount; r++) {
+        while (o < outerCount && outer[o].start + outer[o].length <= inner[r].start) {
+            o++;
+        }
+        if (o == outerCount || outer[o].start > inner[r].start
+            || outer[o].start + outer[o].length < inner[r].start + inner[r].length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compute the potentially visible set of every open cell. Rays are cast all the
+// way around from nine points spread over each cell, rows are spread
+// over the worker pool, and identical sets are merged afterwards.
+void buildPvs(const MazeGrid& grid, PotentiallyVisibleSets& sets)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    int size = grid.width();
+    int window = 2 * VISIBILITY_RADIUS + 1;
+
+    float rayDirX[PVS_RAYS];
+    float rayDirZ[PVS_RAYS];
+    for (int r = 0; r < PVS_RAYS; r++) {
+        float angle = 2.0f * M_PI * (r + 0.5f) / PVS_RAYS;
+        rayDirX[r] = sin(angle);
+        rayDirZ[r] = -cos(angle);
+    }
+    // 3x3 sample points spread over the whole cell
+    const float sampleOffsets[3] = { -0.45f, 0.0f, 0.45f };
+
+    // Per row: the run list of every open cell, in cell order
+    struct RowResult {
+        std::vector<uint32_t> runCounts;
+        std::vector<PvsRun> runs;
+    };
+    std::vector<RowResult> rows(size);
+
+    workerPool().parallelFor(0, size, [&](int j) {
+        thread_local std::vector<uint32_t> stamp;
+        thread_local uint32_t stampValue = 0;
+        if (stamp.size() != (size_t)window * window) {
+            stamp.assign((size_t)window * window, 0);
+            stampValue = 0;
+        }
+
+        std::vector<uint32_t> cells;
+        RowResult& result = rows[j];
+
+        for (int i = 0; i < size; i++) {
+            if (grid.isWall(i, j)) {
+                continue;
+            }
+
+            stampValue++;
+            cells.clear();
+            int originX = i - VISIBILITY_RADIUS;
+            int originZ = j - VISIBILITY_RADIUS;
+
+            for (int p = 0; p < 9; p++) {
+                float posX = i + 0.5f + sampleOffsets[p % 3];
+                float posZ = j + 0.5f + sampleOffsets[p / 3];
+                for (int r = 0; r < PVS_RAYS; r++) {
+                    traceGridRay(grid, posX, posZ, rayDirX[r], rayDirZ[r], [&](int x, int z) {
+                        uint32_t& seen = stamp[(size_t)(z - originZ) * window + (x - originX)];
+                        if (seen != stampValue) {
+                            seen = stampValue;
+                            cells.push_back((uint32_t)(z * size + x));
+                        }
+                    });
+                }
+            }
+
+            // Run-length encode the sorted cell indices
+            std::sort(cells.begin(), cells.end());
+            size_t firstRun = result.runs.size();
+            for (uint32_t cell : cells) {
+                if (result.runs.size() > firstRun && result.runs.back().start + result.runs.back().length == cell) {
+                    result.runs.back().length++;
+                }
+                else {
+                    result.runs.push_back({ cell, 1 });
+                }
+            }
+            result.runCounts.push_back((uint32_t)(result.runs.size() - firstRun));
+        }
+    });
+
+    // Merge identical sets so neighbouring cells with the same view share storage
+    sets.cellSet.assign((size_t)size * size, -1);
+    sets.setFirstRun.assign(1, 0);
+    sets.runs.clear();
+    std::unordered_map<uint64_t, std::vector<int32_t>> setsByHash;
+    size_t totalRuns = 0;
+
+    for (int j = 0; j < size; j++) {
+        const RowResult& result = rows[j];
+        size_t runOffset = 0;
+        size_t cellNumber = 0;
+
+        for (int i = 0; i < size; i++) {
+            if (grid.isWall(i, j)) {
+                continue;
+            }
+
+            const PvsRun* runs = result.runs.data() + runOffset;
+            uint32_t runCount = result.runCounts[cellNumber++];
+            runOffset += runCount;
+            totalRuns += runCount;
+
+            uint64_t hash = 1469598103934665603ull;
+            for (uint32_t r = 0; r < runCount; r++) {
+                hash = (hash ^ runs[r].start) * 1099511628211ull;
+                hash = (hash ^ runs[r].length) * 1099511628211ull;
+            }
+
+            int32_t setId = -1;
+            std::vector<int32_t>& candidates = setsByHash[hash];
+            for (int32_t candidate : candidates) {
+                uint32_t first = sets.setFirstRun[candidate];
+                uint32_t count = sets.setFirstRun[candidate + 1] - first;
+                if (count == runCount && std::equal(runs, runs + runCount, &sets.runs[first],
+                        [](const PvsRun& a, const PvsRun& b) { return a.start == b.start && a.length == b.length; })) {
+                    setId = candidate;
+                    break;
+                }
+            }
+
+            // Otherwise borrow the set of the left or upper neighbour when it covers
+            // this one and isn't much bigger - a slightly larger set only costs a
+            // few extra cells at draw time
+            const int32_t neighbourSets[2] = { sets.cellSet[(size_t)j * size + i - 1], sets.cellSet[(size_t)(j - 1) * size + i] };
+            for (int n = 0; n < 2 && setId < 0; n++) {
+                int32_t candidate = neighbourSets[n];
+                if (candidate < 0) {
+                    continue;
+                }
+                uint32_t first = sets.setFirstRun[candidate];
+                uint32_t count = sets.setFirstRun[candidate + 1] - first;
+                if (pvsRunsCover(&sets.runs[first], count, runs, runCount, 1.25f)) {
+                    setId = candidate;
+                }
+            }
+
+            if (setId < 0) {
+                setId = (int32_t)sets.setFirstRun.size() - 1;
+                sets.runs.insert(sets.runs.end(), runs, runs + runCount);
+                sets.setFirstRun.push_back((uint32_t)sets.runs.size());
+                candidates.push_back(setId);
+            }
+
+            sets.cellSet[(size_t)j * size + i] = setId;
+        }
+    }
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "PVS built in " << elapsedMs << " ms on " << workerPool().threadCount() << " threads: "
+              << sets.setFirstRun.size() - 1 << " unique sets, " << sets.runs.size() << " runs stored ("
+              << totalRuns << " before sharing)" << std::endl;
+}
+
+// On-disk cache layout: header, then cellSet, setFirstRun and runs as raw arrays
+struct PvsFileHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t mazeSize;
+    uint32_t seed;
+    uint64_t gridChecksum;
+    uint64_t cellCount;
+    uint64_t setCount;
+    uint64_t runCount;
+};
+
+bool loadPvs(const MazeGrid& grid, unsigned int seed, PotentiallyVisibleSets& sets, const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    // Only accept a cache built for exactly this maze
+    PvsFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, "MPVS", 4) == 0
+        && header.version == PVS_FILE_VERSION
+        && header.mazeSize == grid.width() - 2
+        && header.seed == seed
+        && header.gridChecksum == grid.checksum()
+        && header.cellCount == (uint64_t)grid.width() * grid.height()
+        && header.setCount > 0;
+
+    if (ok) {
+        sets.cellSet.resize(header.cellCount);
+        sets.setFirstRun.resize(header.setCount + 1);
+        sets.runs.resize(header.runCount);
+        ok = fread(sets.cellSet.data(), sizeof(int32_t), sets.cellSet.size(), file) == sets.cellSet.size()
+            && fread(sets.setFirstRun.data(), sizeof(uint32_t), sets.setFirstRun.size(), file) == sets.setFirstRun.size()
+            && fread(sets.runs.data(), sizeof(PvsRun), sets.runs.size(), file) == sets.runs.size();
+    }
+    fclose(file);
+
+    if (ok) {
+        std::cout << "PVS loaded from " << path << std::endl;
+    }
+    else {
+        sets = PotentiallyVisibleSets();
+    }
+    return ok;
+}
+
+void savePvs(const MazeGrid& grid, unsigned int seed, const PotentiallyVisibleSets& sets, const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "Could not write PVS cache " << path << std::endl;
+        return;
+    }
+
+    PvsFileHeader header;
+    memcpy(header.magic, "MPVS", 4);
+    header.version = PVS_FILE_VERSION;
+    header.mazeSize = grid.width() - 2;
+    header.seed = seed;
+    header.gridChecksum = grid.checksum();
+    header.cellCount = sets.cellSet.size();
+    header.setCount = sets.setFirstRun.size() - 1;
+    header.runCount = sets.runs.size();
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(sets.cellSet.data(), sizeof(int32_t), sets.cellSet.size(), file);
+    fwrite(sets.setFirstRun.data(), sizeof(uint32_t), sets.setFirstRun.size(), file);
+    fwrite(sets.runs.data(), sizeof(PvsRun), sets.runs.size(), file);
+    fclose(file);
+}
+
+// Visible cells from the precomputed set of the player's cell, trimmed to the
+// horizontal field of view (the set itself covers every direction)
+void collectPvsCells()
+{
+    int size = MAZE_SIZE + 2;
+    int cellX = (int)floor(cameraX + 0.5f);
+    int cellZ = (int)floor(cameraZ + 0.5f);
+    int32_t setId = pvs.cellSet[(size_t)cellZ * size + cellX];
+    if (setId < 0) {
+        collectVisibleCells();
+        return;
+    }
+
+    visibleCells.clear();
+
+    float halfFov = atanf(tanf(30.0f * M_PI / 180.0f) * viewAspect) + 2.0f * M_PI / 180.0f;
+    float forwardX = sin(cameraAngle * M_PI / 180.0f);
+    float forwardZ = -cos(cameraAngle * M_PI / 180.0f);
+
+    for (uint32_t r = pvs.setFirstRun[setId]; r < pvs.setFirstRun[setId + 1]; r++) {
+        const PvsRun& run = pvs.runs[r];
+        for (uint32_t cell = run.start; cell < run.start + run.length; cell++) {
+            float dx = (float)(cell % size) - cameraX;
+            float dz = (float)(cell / size) - cameraZ;
+            float distance = sqrtf(dx * dx + dz * dz);
+
+            // The 3x3 block around the camera is always kept, others if any part of
+            // the cell (radius ~0.71) falls inside the view cone
+            if (distance > 2.2f) {
+                float cosAngle = (dx * forwardX + dz * forwardZ) / distance;
+                float angle = acosf(std::max(-1.0f, std::min(1.0f, cosAngle)));
+                if (angle > halfFov + asinf(std::min(1.0f, 0.71f / distance))) {
+                    continue;
+                }
+            }
+            visibleCells.push_back((int)cell);
+        }
+    }
+}
+
+void drawMaze()
+{
+    PROFILE_SCOPE(PROFILE_DRAW_MAZE);
+
+    if (!useBakedMesh) {
+        drawMazeImmediate();
+        return;
+    }
+
+    if (useCulling || !mazeMeshBaked) {
+        // Rebuild just the visible cells into the streaming buffers
+        if (pvsLoaded && usePvs) {
+            collectPvsCells();
+        }
+        else {
+            collectVisibleCells();
+        }
+
+        int width = maze.width();
+        const MazeLighting* lighting = useBakedLighting && mazeLighting.baked() ? &mazeLighting : nullptr;
+        visibleMesh.vertices.clear();
+        visibleMesh.indices.clear();
+        for (int cell : visibleCells) {
+            int i = cell % width;
+            int j = cell / width;
+            addCellWalls(visibleMesh, maze, lighting, i, j);
+            addCellFloorAndCeiling(visibleMesh, lighting, i, j);
+        }
+
+        if (visibleVertexBuffer == 0) {
+            glGenBuffers(1, &visibleVertexBuffer);
+            glGenBuffers(1, &visibleIndexBuffer);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, visibleVertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, visibleMesh.vertices.size() * sizeof(MazeVertex), visibleMesh.vertices.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, visibleIndexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, visibleMesh.indices.size() * sizeof(unsigned int), visibleMesh.indices.data(), GL_STREAM_DRAW);
+
+        drawMazeBuffers(visibleVertexBuffer, visibleIndexBuffer, (int)visibleMesh.indices.size());
+    }
+    else {
+        // Walls, floor and ceiling all come from the baked buffers in a single draw call
+        drawMazeBuffers(mazeVertexBuffer, mazeIndexBuffer, (int)mazeMesh.indices.size());
+    }
+
+    drawMazeMarkers();
+}
+
+void drawMazeBuffers(GLuint vertexBuffer, GLuint indexBuffer, int indexCount)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(MazeVertex), (const void*)offsetof(MazeVertex, x));
+    glNormalPointer(GL_FLOAT, sizeof(MazeVertex), (const void*)offsetof(MazeVertex, nx));
+    glColorPointer(3, GL_FLOAT, sizeof(MazeVertex), (const void*)offsetof(MazeVertex, r));
+
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    frameDrawCalls++;
+    frameTriangles += indexCount / 3;
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// glutSolidCube() without GLUT for offscreen runs: the same unit cube, one
+// glBegin/glEnd per face
+static void solidCube()
+{
+    if (!offscreenMode) {
+        glutSolidCube(1.0f);
+        return;
+    }
+
+    static const float corners[8][3] = {
+        { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f }, { -0.5f, 0.5f, -0.5f },
+        { -0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f }, { -0.5f, 0.5f, 0.5f }
+    };
+    static const float faceNormals[6][3] = {
+        { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+    };
+    static const int faceCorners[6][4] = {   // counter-clockwise seen from outside
+        { 1, 2, 6, 5 }, { 0, 4, 7, 3 }, { 3, 7, 6, 2 }, { 0, 1, 5, 4 }, { 4, 5, 6, 7 }, { 0, 3, 2, 1 }
+    };
+    for (int f = 0; f < 6; f++) {
+        glBegin(GL_QUADS);
+        glNormal3fv(faceNormals[f]);
+        for (int c = 0; c < 4; c++) {
+            glVertex3fv(corners[faceCorners[f][c]]);
+        }
+        glEnd();
+    }
+}
+
+// Original renderer - one glutSolidCube per cell. Kept for before/after comparison.
+// Each cube counts as 6 draw calls (one glBegin/glEnd per face) and 12 triangles.
+void drawMazeImmediate()
+{
+    // Draw each cell of the grid - the endless window is taller than it is wide
+    for (int j = 0; j < maze.height(); j++) {
+        for (int i = 0; i < maze.width(); i++) {
+            if (maze.isWall(i, j)) { // Wall
+                // All walls are the same color now (including boundary walls)
                 glColor3f(0.5f, 0.5f, 0.7f); // Blue-ish for all walls
 
                 // Draw wall cube
                 glPushMatrix();
                 glTranslatef(i, 0.5f, j);   //translated to the height of  0.5
-                glutSolidCube(1.0f);
+                solidCube();
                 glPopMatrix();
+                frameDrawCalls += 6;
+                frameTriangles += 12;
             }
             else { // Floor and ceiling
                 // Draw floor
@@ -400,40 +2411,409 @@ void drawMaze()
                 glPushMatrix();
                 glTranslatef(i, 0.0f, j);      //push the location on 0.0f which is on the ground
                 glScalef(1.0f, 0.01f, 1.0f);    //   scale the cube to be flat in y axis
-                glutSolidCube(1.0f);
+                solidCube();
                 glPopMatrix();
 
-                // Draw ceiling
-                glColor3f(0.2f, 0.2f, 0.2f);
-                glPushMatrix();
-                glTranslatef(i, 1.0f, j);
-                glScalef(1.0f, 0.01f, 1.0f);
-                glutSolidCube(1.0f);
-                glPopMatrix();
-            }
+                // Draw ceiling
+                glColor3f(0.2f, 0.2f, 0.2f);
+                glPushMatrix();
+                glTranslatef(i, 1.0f, j);
+                glScalef(1.0f, 0.01f, 1.0f);
+                solidCube();
+                glPopMatrix();
+                frameDrawCalls += 12;
+                frameTriangles += 24;
+            }
+        }
+    }
+
+    drawMazeMarkers();
+}
+
+void drawMazeMarkers()
+{
+    if (endlessMode) {
+        return;
+    }
+
+    // Draw special markers for start and goal
+    // Start marker
+    glColor3f(0.0f, 1.0f, 0.0f);
+    glPushMatrix();
+    glTranslatef(1.0f, 0.1f, 1.0f);
+    glScalef(0.3f, 0.1f, 0.3f);
+    solidCube();
+    glPopMatrix();
+
+    // Goal marker
+    glColor3f(1.0f, 0.0f, 0.0f);
+    glPushMatrix();
+    glTranslatef(MAZE_SIZE - 0.5f, 0.1f, MAZE_SIZE - 0.5f);
+    glScalef(0.3f, 0.1f, 0.3f);
+    solidCube();
+    glPopMatrix();
+
+    frameDrawCalls += 12;
+    frameTriangles += 24;
+
+    // The lanterns near the camera, hanging from the ceiling. They give light
+    // rather than take it, so they are drawn unlit.
+    if (useBakedLighting && mazeLighting.baked()) {
+        glDisable(GL_LIGHTING);
+        glColor3f(1.0f, 0.85f, 0.5f);
+        for (size_t l = 0; l < mazeLighting.lanternX.size(); l++) {
+            float x = (float)mazeLighting.lanternX[l];
+            float z = (float)mazeLighting.lanternZ[l];
+            if (fabsf(x - cameraX) > LANTERN_DRAW_DISTANCE || fabsf(z - cameraZ) > LANTERN_DRAW_DISTANCE) {
+                continue;
+            }
+            glPushMatrix();
+            glTranslatef(x, LANTERN_HEIGHT, z);
+            glScalef(0.12f, 0.16f, 0.12f);
+            solidCube();
+            glPopMatrix();
+            frameDrawCalls += 6;
+            frameTriangles += 12;
+        }
+        glEnable(GL_LIGHTING);
+    }
+}
+
+// Raycast the view on the CPU and put it on screen as a single textured quad
+void drawRaycastView()
+{
+    PROFILE_SCOPE(PROFILE_DRAW_MAZE);
+
+    raycastFrame(maze, cameraX, cameraZ, cameraAngle, playerY, sceneWidth, sceneHeight, raycastView);
+
+    // Same size as last frame: just replace the texels
+    if (raycastTexture == 0) {
+        glGenTextures(1, &raycastTexture);
+    }
+    glBindTexture(GL_TEXTURE_2D, raycastTexture);
+    if (raycastTextureWidth != raycastView.width || raycastTextureHeight != raycastView.height) {
+        raycastTextureWidth = raycastView.width;
+        raycastTextureHeight = raycastView.height;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, raycastTextureWidth, raycastTextureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     raycastView.pixels.data());
+    }
+    else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, raycastTextureWidth, raycastTextureHeight, GL_RGBA, GL_UNSIGNED_BYTE,
+                        raycastView.pixels.data());
+    }
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0, 1, 0, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    // Row 0 of the frame is the top of the screen
+    glEnable(GL_TEXTURE_2D);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 1.0f);
+    glVertex2f(0.0f, 0.0f);
+    glTexCoord2f(1.0f, 1.0f);
+    glVertex2f(1.0f, 0.0f);
+    glTexCoord2f(1.0f, 0.0f);
+    glVertex2f(1.0f, 1.0f);
+    glTexCoord2f(0.0f, 0.0f);
+    glVertex2f(0.0f, 1.0f);
+    glEnd();
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    frameDrawCalls++;
+    frameTriangles += 2;
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
+}
+
+// Every agent of the newest snapshot as a point just above the floor, wanderers green
+// and chasers red. The points shrink with distance and the depth test hides
+// the ones behind walls.
+void drawAgents()
+{
+    PROFILE_SCOPE(PROFILE_DRAW_AGENTS);
+
+    const AgentSnapshot& snapshot = agentSnapshots.read();
+    size_t count = snapshot.x.size();
+    if (count == 0) {
+        return;
+    }
+
+    agentVertices.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        bool chaser = snapshot.kind[i] == AGENT_CHASER;
+        agentVertices[i] = { snapshot.x[i], AGENT_HEIGHT, snapshot.z[i], (uint8_t)(chaser ? 230 : 60), (uint8_t)(chaser ? 50 : 220),
+                             60, 255 };
+    }
+    if (agentVertexBuffer == 0) {
+        glGenBuffers(1, &agentVertexBuffer);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, agentVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(AgentVertex), agentVertices.data(), GL_STREAM_DRAW);
+
+    // Size in pixels is AGENT_POINT_SIZE world units at the focal length of the
+    // 60 degree projection, divided by the distance
+    float focal = sceneHeight * 0.5f / tanf(30.0f * M_PI / 180.0f);
+    const GLfloat attenuation[3] = { 0.0f, 0.0f, 1.0f };
+    glPointParameterfv(GL_POINT_DISTANCE_ATTENUATION, attenuation);
+    glPointParameterf(GL_POINT_SIZE_MAX, 32.0f);
+    glPointSize(AGENT_POINT_SIZE * focal);
+    glDisable(GL_LIGHTING);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(AgentVertex), (const void*)offsetof(AgentVertex, x));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(AgentVertex), (const void*)offsetof(AgentVertex, r));
+    glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+    frameDrawCalls++;
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    const GLfloat noAttenuation[3] = { 1.0f, 0.0f, 0.0f };
+    glPointParameterfv(GL_POINT_DISTANCE_ATTENUATION, noAttenuation);
+    glPointSize(1.0f);
+    glEnable(GL_LIGHTING);
+}
+
+// Hint overlay in the 3D view - a trail of small glowing tiles on the floor
+void drawHintPath()
+{
+    PROFILE_SCOPE(PROFILE_DRAW_HINTS);
+
+    if (hintPath.size() < 2) {
+        return;
+    }
+
+    int width = maze.width();
+    glDisable(GL_LIGHTING);
+    glBegin(GL_QUADS);
+    for (size_t s = 1; s < hintPath.size(); s++) {
+        float x = (float)(hintPath[s] % width);
+        float z = (float)(hintPath[s] / width);
+        float fade = 1.0f - (float)s / (hintPath.size() + 1);
+        glColor3f(0.2f * fade, 0.9f * fade, 1.0f * fade);
+        glVertex3f(x - 0.12f, 0.01f, z + 0.12f);
+        glVertex3f(x + 0.12f, 0.01f, z + 0.12f);
+        glVertex3f(x + 0.12f, 0.01f, z - 0.12f);
+        glVertex3f(x - 0.12f, 0.01f, z - 0.12f);
+    }
+    glEnd();
+    glEnable(GL_LIGHTING);
+
+    frameDrawCalls++;
+    frameTriangles += 2 * (int)(hintPath.size() - 1);
+}
+
+// Colour of texel (tx, tz) of the minimap of grid at scale cells per texel. A
+// block of cells shows as open if any of its cells is, and with fog of war only
+// once one of them has been explored (explored is null before any has been).
+static void minimapTexelColor(const MazeGrid& grid, const MazeGrid* explored, bool fog, int scale, int tx, int tz, uint8_t* rgba)
+{
+    int x0 = tx * scale;
+    int z0 = tz * scale;
+    int x1 = std::min(x0 + scale, grid.width());
+    int z1 = std::min(z0 + scale, grid.height());
+    int goalCell = grid.width() - 2;
+
+    bool open = false;
+    bool seen = !fog;
+    bool start = false;
+    bool goal = false;
+    for (int z = z0; z < z1; z++) {
+        for (int x = x0; x < x1; x++) {
+            open = open || !grid.isWall(x, z);
+            seen = seen || (explored && !explored->isWall(x, z));
+            start = start || (x == 1 && z == 1);
+            goal = goal || (x == goalCell && z == goalCell);
+        }
+    }
+
+    uint8_t r, g, b;
+    if (!seen) {
+        r = 0; g = 0; b = 0;                    // Unexplored (fog)
+    }
+    else if (!endlessMode && start) {
+        r = 0; g = 204; b = 0;                  // Start (green)
+    }
+    else if (!endlessMode && goal) {
+        r = 204; g = 0; b = 0;                  // End (red)
+    }
+    else if (open) {
+        r = 51; g = 51; b = 51;                 // Regular path (dark gray)
+    }
+    else {
+        r = 153; g = 153; b = 204;              // Walls, consistent with 3D view
+    }
+    rgba[0] = r;
+    rgba[1] = g;
+    rgba[2] = b;
+    rgba[3] = 255;
+}
+
+// Recompute texels [tx0, tx1] x [tz0, tz1] and upload just that rectangle
+static void updateMinimapTexels(int tx0, int tz0, int tx1, int tz1)
+{
+    tx0 = std::max(tx0, 0);
+    tz0 = std::max(tz0, 0);
+    tx1 = std::min(tx1, minimapTextureWidth - 1);
+    tz1 = std::min(tz1, minimapTextureHeight - 1);
+    if (tx0 > tx1 || tz0 > tz1) {
+        return;
+    }
+
+    for (int tz = tz0; tz <= tz1; tz++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            minimapTexelColor(maze, &exploredCells, fogOfWar, minimapScale, tx, tz,
+                              &minimapPixels[((size_t)tz * minimapTextureWidth + tx) * 4]);
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, minimapTexture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, minimapTextureWidth);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, tx0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, tz0);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, tx0, tz0, tx1 - tx0 + 1, tz1 - tz0 + 1, GL_RGBA, GL_UNSIGNED_BYTE, minimapPixels.data());
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Mark the cell the player is in and its eight neighbours as explored. Runs
+// every frame, minimap shown or not; the texels follow on the next draw.
+void updateExploredCells()
+{
+    if (exploredCells.width() != maze.width() || exploredCells.height() != maze.height()) {
+        exploredCells.resize(maze.width(), maze.height(), true);
+        exploredWindowChunk = endlessWindowChunk;
+        exploredCellX = -1;
+        minimapDirty = true;
+    }
+
+    // Keep the explored cells lined up with a slid endless window
+    if (endlessMode && exploredWindowChunk != endlessWindowChunk) {
+        int shiftRows = (int)((endlessWindowChunk - exploredWindowChunk) * ENDLESS_CHUNK_ROWS);
+        MazeGrid previous(exploredCells);
+        for (int z = 0; z < exploredCells.height(); z++) {
+            int from = z + shiftRows;
+            if (from >= 0 && from < previous.height()) {
+                std::copy(previous.row(from), previous.row(from) + previous.wordsPerRow(), exploredCells.row(z));
+            }
+            else {
+                std::fill(exploredCells.row(z), exploredCells.row(z) + exploredCells.wordsPerRow(), ~0ull);
+            }
+        }
+        exploredWindowChunk = endlessWindowChunk;
+        minimapDirty = true;
+    }
+
+    int cellX = (int)floor(cameraX + 0.5f);
+    int cellZ = (int)floor(cameraZ + 0.5f);
+    if (cellX == exploredCellX && cellZ == exploredCellZ) {
+        return;
+    }
+    exploredCellX = cellX;
+    exploredCellZ = cellZ;
+
+    int x0 = std::max(0, cellX - 1);
+    int z0 = std::max(0, cellZ - 1);
+    int x1 = std::min(maze.width() - 1, cellX + 1);
+    int z1 = std::min(maze.height() - 1, cellZ + 1);
+    for (int z = z0; z <= z1; z++) {
+        for (int x = x0; x <= x1; x++) {
+            exploredCells.setOpen(x, z);
+        }
+    }
+
+    if (exploredMinX > exploredMaxX) {
+        exploredMinX = x0;
+        exploredMinZ = z0;
+        exploredMaxX = x1;
+        exploredMaxZ = z1;
+    }
+    else {
+        exploredMinX = std::min(exploredMinX, x0);
+        exploredMinZ = std::min(exploredMinZ, z0);
+        exploredMaxX = std::max(exploredMaxX, x1);
+        exploredMaxZ = std::max(exploredMaxZ, z1);
+    }
+}
+
+// Rasterize the whole minimap of grid, picking the scale that keeps the texture
+// within MINIMAP_TEXTURE_MAX_SIZE. Touches no globals, so the next level's
+// minimap can be built in the background.
+void rasterizeMinimap(const MazeGrid& grid, const MazeGrid* explored, bool fog, int& scale, int& width, int& height,
+                      std::vector<uint8_t>& pixels)
+{
+    scale = 1;
+    while ((grid.width() + scale - 1) / scale > MINIMAP_TEXTURE_MAX_SIZE
+           || (grid.height() + scale - 1) / scale > MINIMAP_TEXTURE_MAX_SIZE) {
+        scale++;
+    }
+    width = (grid.width() + scale - 1) / scale;
+    height = (grid.height() + scale - 1) / scale;
+
+    pixels.resize((size_t)width * height * 4);
+    for (int tz = 0; tz < height; tz++) {
+        for (int tx = 0; tx < width; tx++) {
+            minimapTexelColor(grid, explored, fog, scale, tx, tz, &pixels[((size_t)tz * width + tx) * 4]);
         }
     }
+}
 
-    // Draw special markers for start and goal
-    // Start marker
-    glColor3f(0.0f, 1.0f, 0.0f);
-    glPushMatrix();
-    glTranslatef(1.5f, 0.1f, 1.5f);
-    glScalef(0.3f, 0.1f, 0.3f);
-    glutSolidCube(1.0f);
-    glPopMatrix();
+// Upload minimapPixels as the whole minimap texture
+void uploadMinimapTexture()
+{
+    if (minimapTexture == 0) {
+        glGenTextures(1, &minimapTexture);
+    }
+    glBindTexture(GL_TEXTURE_2D, minimapTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, minimapTextureWidth, minimapTextureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, minimapPixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    minimapDirty = false;
+}
 
-    // Goal marker
-    glColor3f(1.0f, 0.0f, 0.0f);
-    glPushMatrix();
-    glTranslatef(MAZE_SIZE - 0.5f, 0.1f, MAZE_SIZE - 0.5f);
-    glScalef(0.3f, 0.1f, 0.3f);
-    glutSolidCube(1.0f);
-    glPopMatrix();
+// Bring the minimap texture up to date: a full rebuild when the maze (or the
+// endless window) changed, otherwise only the texels of newly explored cells
+void updateMinimapTexture()
+{
+    if (minimapDirty) {
+        rasterizeMinimap(maze, &exploredCells, fogOfWar, minimapScale, minimapTextureWidth, minimapTextureHeight, minimapPixels);
+        uploadMinimapTexture();
+    }
+    else if (fogOfWar && exploredMinX <= exploredMaxX) {
+        updateMinimapTexels(exploredMinX / minimapScale, exploredMinZ / minimapScale,
+                            exploredMaxX / minimapScale, exploredMaxZ / minimapScale);
+    }
+
+    exploredMinX = 0;
+    exploredMaxX = -1;
 }
 
 void drawMinimap()
 {
+    PROFILE_SCOPE(PROFILE_DRAW_MINIMAP);
+
     // Disable lighting and depth testing for 2D elements
     glDisable(GL_LIGHTING);
     glDisable(GL_DEPTH_TEST);
@@ -453,8 +2833,16 @@ void drawMinimap()
     int minimapX = WINDOW_WIDTH - minimapSize - 10;
     int minimapY = 10;
 
+    // Rows shown - the whole maze, or a square around the player in endless mode
+    int mapColumns = maze.width();
+    int mapRows = std::min(maze.width(), maze.height());
+    int firstRow = 0;
+    if (endlessMode) {
+        firstRow = std::max(0, std::min((int)cameraZ - mapRows / 2, maze.height() - mapRows));
+    }
+
     // Calculate cell size (smaller for larger maze)
-    float cellSizeFloat = (float)minimapSize / (MAZE_SIZE + 2);
+    float cellSizeFloat = (float)minimapSize / mapColumns;
 
     // Draw minimap background with border
     // Background
@@ -475,38 +2863,42 @@ void drawMinimap()
     glVertex2f(minimapX - 2, minimapY + minimapSize + 2);
     glEnd();
 
-    // Draw maze cells
-    for (int i = 0; i < MAZE_SIZE + 2; i++) {
-        for (int j = 0; j < MAZE_SIZE + 2; j++) {
-            float x = minimapX + i * cellSizeFloat;
-            float y = minimapY + j * cellSizeFloat;
-
-            if (maze[i][j] == 1) {
-                // All walls are the same color
-                glColor3f(0.6f, 0.6f, 0.8f); // Consistent with 3D view
-            }
-            else {
-                // Draw path
-                if ((i == 1 && j == 1) || (i == MAZE_SIZE && j == MAZE_SIZE)) {
-                    if (i == 1 && j == 1) {
-                        glColor3f(0.0f, 0.8f, 0.0f); // Start (green)
-                    }
-                    else {
-                        glColor3f(0.8f, 0.0f, 0.0f); // End (red)
-                    }
-                }
-                else {
-                    glColor3f(0.2f, 0.2f, 0.2f); // Regular path (dark gray)
-                }
-            }
-
-            glBegin(GL_QUADS);
-            glVertex2f(x, y);
-            glVertex2f(x + cellSizeFloat, y);
-            glVertex2f(x + cellSizeFloat, y + cellSizeFloat);
-            glVertex2f(x, y + cellSizeFloat);
-            glEnd();
+    // Maze cells - one textured quad showing rows [firstRow, firstRow + mapRows)
+    updateMinimapTexture();
+    float mapWidth = mapColumns * cellSizeFloat;
+    float mapHeight = mapRows * cellSizeFloat;
+    float u1 = (float)mapColumns / (minimapTextureWidth * minimapScale);
+    float v0 = (float)firstRow / (minimapTextureHeight * minimapScale);
+    float v1 = (float)(firstRow + mapRows) / (minimapTextureHeight * minimapScale);
+
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, minimapTexture);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, v0);
+    glVertex2f(minimapX, minimapY);
+    glTexCoord2f(u1, v0);
+    glVertex2f(minimapX + mapWidth, minimapY);
+    glTexCoord2f(u1, v1);
+    glVertex2f(minimapX + mapWidth, minimapY + mapHeight);
+    glTexCoord2f(0.0f, v1);
+    glVertex2f(minimapX, minimapY + mapHeight);
+    glEnd();
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+
+    // Hint path - drawn over the cells, under the player marker
+    if (showHints && hintPath.size() > 1) {
+        glColor3f(0.2f, 0.9f, 1.0f);
+        glLineWidth(2.0f);
+        glBegin(GL_LINE_STRIP);
+        for (int cell : hintPath) {
+            float cellX = (float)(cell % maze.width());
+            float cellZ = (float)(cell / maze.width());
+            glVertex2f(minimapX + (cellX + 0.5f) * cellSizeFloat, minimapY + (cellZ + 0.5f - firstRow) * cellSizeFloat);
         }
+        glEnd();
     }
 
     // Draw player position with better visibility
@@ -514,43 +2906,38 @@ void drawMinimap()
     glColor3f(0.0f, 0.0f, 0.0f);
     glPointSize(8.0f);
     glBegin(GL_POINTS);
-    glVertex2f(minimapX + playerX * cellSizeFloat, minimapY + playerZ * cellSizeFloat);
+    glVertex2f(minimapX + cameraX * cellSizeFloat, minimapY + (cameraZ - firstRow) * cellSizeFloat);
     glEnd();
 
     // Then draw the yellow player marker
     glColor3f(1.0f, 1.0f, 0.0f); // Yellow for player
     glPointSize(6.0f);
     glBegin(GL_POINTS);
-    glVertex2f(minimapX + playerX * cellSizeFloat, minimapY + playerZ * cellSizeFloat);
+    glVertex2f(minimapX + cameraX * cellSizeFloat, minimapY + (cameraZ - firstRow) * cellSizeFloat);
     glEnd();
 
     // Draw player direction with better visibility
-    float dx = sin(playerAngle * M_PI / 180.0f) * 8.0f; // Longer direction indicator
-    float dz = -cos(playerAngle * M_PI / 180.0f) * 8.0f;
+    float dx = sin(cameraAngle * M_PI / 180.0f) * 8.0f; // Longer direction indicator
+    float dz = -cos(cameraAngle * M_PI / 180.0f) * 8.0f;
 
     // Black outline for direction line
     glColor3f(0.0f, 0.0f, 0.0f);
     glLineWidth(3.0f);
     glBegin(GL_LINES);
-    glVertex2f(minimapX + playerX * cellSizeFloat, minimapY + playerZ * cellSizeFloat);
-    glVertex2f(minimapX + playerX * cellSizeFloat + dx, minimapY + playerZ * cellSizeFloat + dz);
+    glVertex2f(minimapX + cameraX * cellSizeFloat, minimapY + (cameraZ - firstRow) * cellSizeFloat);
+    glVertex2f(minimapX + cameraX * cellSizeFloat + dx, minimapY + (cameraZ - firstRow) * cellSizeFloat + dz);
     glEnd();
 
     // Yellow direction line
     glColor3f(1.0f, 1.0f, 0.0f);
     glLineWidth(1.5f);
     glBegin(GL_LINES);
-    glVertex2f(minimapX + playerX * cellSizeFloat, minimapY + playerZ * cellSizeFloat);
-    glVertex2f(minimapX + playerX * cellSizeFloat + dx, minimapY + playerZ * cellSizeFloat + dz);
+    glVertex2f(minimapX + cameraX * cellSizeFloat, minimapY + (cameraZ - firstRow) * cellSizeFloat);
+    glVertex2f(minimapX + cameraX * cellSizeFloat + dx, minimapY + (cameraZ - firstRow) * cellSizeFloat + dz);
     glEnd();
 
     // Draw minimap title
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glRasterPos2f(minimapX, minimapY + minimapSize + 15);
-    const char* minimapTitle = "MAZE MAP";
-    for (int i = 0; minimapTitle[i] != '\0'; i++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, minimapTitle[i]);
-    }
+    hudText(HUD_TEXT_MINIMAP_TITLE, minimapX, minimapY + minimapSize + 15, HUD_FONT_SMALL, 1.0f, 1.0f, 1.0f, "MAZE MAP");
 
     // Restore matrices and states
     glMatrixMode(GL_PROJECTION);
@@ -563,248 +2950,641 @@ void drawMinimap()
     glEnable(GL_LIGHTING);
 }
 
-void drawTimer()
+static void* hudGlutFont(int font)
+{
+    if (font == HUD_FONT_MEDIUM) {
+        return GLUT_BITMAP_HELVETICA_18;
+    }
+    if (font == HUD_FONT_LARGE) {
+        return GLUT_BITMAP_TIMES_ROMAN_24;
+    }
+    return GLUT_BITMAP_HELVETICA_12;
+}
+
+// Offscreen stand-in for the GLUT fonts: a solid block per printable character,
+// sized roughly like the font, so the HUD costs about the same to lay out and draw
+static void bakeBlockGlyphs(std::vector<uint8_t>& atlas)
 {
-    // Calculate elapsed time
-    int elapsedTime = gameFinished ? finalTime : (int)(time(NULL) - gameStartTime);
+    const int blockAdvance[HUD_FONT_COUNT] = { 7, 10, 13 };
+    const int blockHeight[HUD_FONT_COUNT] = { 9, 13, 17 };
+    for (int font = 0; font < HUD_FONT_COUNT; font++) {
+        uint8_t* band = &atlas[(size_t)font * HUD_FONT_BAND_HEIGHT * HUD_ATLAS_WIDTH];
+        for (int c = 0; c < 128; c++) {
+            hudGlyphAdvance[font][c] = c < 32 ? 0 : blockAdvance[font];
+            hudGlyphBox[font][c] = HudGlyphBox{ 0, 0, 0, 0 };
+            if (c <= 32) {
+                continue;
+            }
+            HudGlyphBox box = { (uint8_t)HUD_GLYPH_MARGIN, (uint8_t)HUD_GLYPH_BASELINE,
+                                (uint8_t)(HUD_GLYPH_MARGIN + blockAdvance[font] - 2), (uint8_t)(HUD_GLYPH_BASELINE + blockHeight[font]) };
+            int cellX = ((c - 32) % 16) * HUD_GLYPH_CELL;
+            int cellY = ((c - 32) / 16) * HUD_GLYPH_CELL;
+            for (int y = box.y0; y < box.y1; y++) {
+                memset(&band[(size_t)(cellY + y) * HUD_ATLAS_WIDTH + cellX + box.x0], 255, box.x1 - box.x0);
+            }
+            hudGlyphBox[font][c] = box;
+        }
+    }
+}
 
-    // Convert to minutes:seconds format
-    int minutes = elapsedTime / 60;
-    int seconds = elapsedTime % 60;
-    char timeString[32];
-    snprintf(timeString, sizeof(timeString), "Time: %02d:%02d", minutes, seconds);
+static void uploadHudFontAtlas(std::vector<uint8_t>& atlas)
+{
+    for (int y = HUD_ATLAS_HEIGHT - HUD_SOLID_TEXELS; y < HUD_ATLAS_HEIGHT; y++) {
+        memset(&atlas[(size_t)y * HUD_ATLAS_WIDTH + HUD_ATLAS_WIDTH - HUD_SOLID_TEXELS], 255, HUD_SOLID_TEXELS);
+    }
 
-    // Save current matrices
+    glGenTextures(1, &hudAtlasTexture);
+    glBindTexture(GL_TEXTURE_2D, hudAtlasTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT, 0, GL_ALPHA, GL_UNSIGNED_BYTE, atlas.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Render every glyph of every font once with glutBitmapCharacter into the back
+// buffer, read the bands back and keep them as an alpha texture
+void bakeHudFontAtlas()
+{
+    std::vector<uint8_t> atlas((size_t)HUD_ATLAS_WIDTH * HUD_ATLAS_HEIGHT, 0);
+    if (offscreenMode) {
+        bakeBlockGlyphs(atlas);
+        uploadHudFontAtlas(atlas);
+        return;
+    }
+
+    glPushAttrib(GL_COLOR_BUFFER_BIT | GL_ENABLE_BIT | GL_VIEWPORT_BIT | GL_CURRENT_BIT | GL_PIXEL_MODE_BIT);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glViewport(0, 0, HUD_ATLAS_WIDTH, HUD_FONT_BAND_HEIGHT);
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, HUD_ATLAS_WIDTH, 0, HUD_FONT_BAND_HEIGHT, -1, 1);
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix();
+    glLoadIdentity();
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    for (int font = 0; font < HUD_FONT_COUNT; font++) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        glColor3f(1.0f, 1.0f, 1.0f);
+        for (int c = 0; c < 128; c++) {
+            hudGlyphAdvance[font][c] = 0;
+            if (c < 32) {
+                continue;
+            }
+            int cell = c - 32;
+            glRasterPos2i((cell % 16) * HUD_GLYPH_CELL + HUD_GLYPH_MARGIN, (cell / 16) * HUD_GLYPH_CELL + HUD_GLYPH_BASELINE);
+            glutBitmapCharacter(hudGlutFont(font), c);
+            hudGlyphAdvance[font][c] = glutBitmapWidth(hudGlutFont(font), c);
+        }
+        const uint8_t* band = &atlas[(size_t)font * HUD_FONT_BAND_HEIGHT * HUD_ATLAS_WIDTH];
+        glReadPixels(0, 0, HUD_ATLAS_WIDTH, HUD_FONT_BAND_HEIGHT, GL_RED, GL_UNSIGNED_BYTE, (void*)band);
+
+        // Trim each quad to the glyph's ink so the batch doesn't blend empty pixels
+        for (int c = 32; c < 128; c++) {
+            int cellX = ((c - 32) % 16) * HUD_GLYPH_CELL;
+            int cellY = ((c - 32) / 16) * HUD_GLYPH_CELL;
+            HudGlyphBox box = { HUD_GLYPH_CELL, HUD_GLYPH_CELL, 0, 0 };
+            for (int y = 0; y < HUD_GLYPH_CELL; y++) {
+                for (int x = 0; x < HUD_GLYPH_CELL; x++) {
+                    if (band[(size_t)(cellY + y) * HUD_ATLAS_WIDTH + cellX + x]) {
+                        box.x0 = std::min<uint8_t>(box.x0, x);
+                        box.y0 = std::min<uint8_t>(box.y0, y);
+                        box.x1 = std::max<uint8_t>(box.x1, x + 1);
+                        box.y1 = std::max<uint8_t>(box.y1, y + 1);
+                    }
+                }
+            }
+            hudGlyphBox[font][c] = box.x0 < box.x1 ? box : HudGlyphBox{ 0, 0, 0, 0 };
+        }
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glPopAttrib();
+
+    uploadHudFontAtlas(atlas);
+}
+
+// Width in pixels from the cached advances - no GLUT calls
+int hudTextWidth(int font, const char* text)
+{
+    int width = 0;
+    for (int i = 0; text[i] != '\0'; i++) {
+        width += hudGlyphAdvance[font][(unsigned char)text[i] & 127];
+    }
+    return width;
+}
+
+// Lay out one string: a quad per visible character, covering its ink in the atlas
+static void layoutHudText(HudTextSlot& slot)
+{
+    slot.vertices.clear();
+    float penX = slot.x;
+    for (size_t i = 0; i < slot.text.size(); i++) {
+        int c = (unsigned char)slot.text[i] & 127;
+        const HudGlyphBox& box = hudGlyphBox[slot.font][c];
+        if (box.x0 < box.x1) {
+            int cellX = ((c - 32) % 16) * HUD_GLYPH_CELL;
+            int cellY = slot.font * HUD_FONT_BAND_HEIGHT + ((c - 32) / 16) * HUD_GLYPH_CELL;
+            float x0 = penX - HUD_GLYPH_MARGIN + box.x0;
+            float y0 = slot.y - HUD_GLYPH_BASELINE + box.y0;
+            float x1 = penX - HUD_GLYPH_MARGIN + box.x1;
+            float y1 = slot.y - HUD_GLYPH_BASELINE + box.y1;
+            float u0 = (float)(cellX + box.x0) / HUD_ATLAS_WIDTH;
+            float v0 = (float)(cellY + box.y0) / HUD_ATLAS_HEIGHT;
+            float u1 = (float)(cellX + box.x1) / HUD_ATLAS_WIDTH;
+            float v1 = (float)(cellY + box.y1) / HUD_ATLAS_HEIGHT;
+            slot.vertices.push_back({ x0, y0, u0, v0, slot.r, slot.g, slot.b });
+            slot.vertices.push_back({ x1, y0, u1, v0, slot.r, slot.g, slot.b });
+            slot.vertices.push_back({ x1, y1, u1, v1, slot.r, slot.g, slot.b });
+            slot.vertices.push_back({ x0, y1, u0, v1, slot.r, slot.g, slot.b });
+        }
+        penX += hudGlyphAdvance[slot.font][c];
+    }
+}
 
-    // Set up 2D orthographic projection for UI elements
+// Window-sized ortho projection and the 2D state every HUD draw shares
+static void beginHudDraw()
+{
     glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
     glLoadIdentity();
     glOrtho(0, WINDOW_WIDTH, 0, WINDOW_HEIGHT, -1, 1);
     glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
     glLoadIdentity();
-
-    // Disable lighting for 2D elements
     glDisable(GL_LIGHTING);
     glDisable(GL_DEPTH_TEST);
+}
 
-    // Draw timer text
-    glColor3f(1.0f, 1.0f, 1.0f);              //color of the text
-    glRasterPos2f(10, WINDOW_HEIGHT - 20);    //position of the text
-    for (int i = 0; timeString[i] != '\0'; i++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, timeString[i]);
-    }
-
-    // Re-enable lighting and depth testing
+static void endHudDraw()
+{
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_LIGHTING);
-
-    // Restore matrices
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
     glPopMatrix();
 }
 
+// Queue a HUD string for this frame at (x, y) in window coordinates (baseline).
+// In the old mode it is drawn right away with glutBitmapCharacter instead.
+void hudText(int slotIndex, float x, float y, int font, float r, float g, float b, const char* text)
+{
+    if (!useBatchedText) {
+        beginHudDraw();
+        glColor3f(r, g, b);
+        glRasterPos2f(x, y);
+        for (int i = 0; text[i] != '\0'; i++) {
+            glutBitmapCharacter(hudGlutFont(font), text[i]);
+        }
+        endHudDraw();
+        return;
+    }
+
+    HudTextSlot& slot = hudTextSlots[slotIndex];
+    slot.used = true;
+    if (slot.text == text && slot.width == 0.0f && slot.x == x && slot.y == y && slot.font == font && slot.r == r
+        && slot.g == g && slot.b == b) {
+        return;
+    }
+
+    slot.text = text;
+    slot.x = x;
+    slot.y = y;
+    slot.width = 0.0f;
+    slot.height = 0.0f;
+    slot.font = font;
+    slot.r = r;
+    slot.g = g;
+    slot.b = b;
+    layoutHudText(slot);
+    hudTextBatchDirty = true;
+}
+
+// Queue a solid quad with its lower left corner at (x, y), drawn in slot order
+// with the text (or right away in the old mode)
+void hudQuad(int slotIndex, float x, float y, float width, float height, float r, float g, float b)
+{
+    if (!useBatchedText) {
+        beginHudDraw();
+        glColor3f(r, g, b);
+        glBegin(GL_QUADS);
+        glVertex2f(x, y);
+        glVertex2f(x + width, y);
+        glVertex2f(x + width, y + height);
+        glVertex2f(x, y + height);
+        glEnd();
+        endHudDraw();
+        return;
+    }
+
+    HudTextSlot& slot = hudTextSlots[slotIndex];
+    slot.used = true;
+    if (slot.text.empty() && slot.x == x && slot.y == y && slot.width == width && slot.height == height && slot.r == r
+        && slot.g == g && slot.b == b) {
+        return;
+    }
+
+    slot.text.clear();
+    slot.x = x;
+    slot.y = y;
+    slot.width = width;
+    slot.height = height;
+    slot.r = r;
+    slot.g = g;
+    slot.b = b;
+    float u = (HUD_ATLAS_WIDTH - HUD_SOLID_TEXELS * 0.5f) / HUD_ATLAS_WIDTH;
+    float v = (HUD_ATLAS_HEIGHT - HUD_SOLID_TEXELS * 0.5f) / HUD_ATLAS_HEIGHT;
+    slot.vertices.assign({ { x, y, u, v, r, g, b }, { x + width, y, u, v, r, g, b },
+                           { x + width, y + height, u, v, r, g, b }, { x, y + height, u, v, r, g, b } });
+    hudTextBatchDirty = true;
+}
+
+// Draw every string queued this frame in one call. The batch is only put
+// together again when a slot changed or a different set of slots is in use.
+void drawHudText()
+{
+    PROFILE_SCOPE(PROFILE_DRAW_HUD_TEXT);
+
+    uint64_t slotsUsed = 0;
+    for (int s = 0; s < HUD_TEXT_SLOT_COUNT; s++) {
+        if (hudTextSlots[s].used) {
+            slotsUsed |= 1ull << s;
+        }
+        hudTextSlots[s].used = false;
+    }
+    if (!useBatchedText || slotsUsed == 0) {
+        return;
+    }
+
+    if (hudTextBatchDirty || slotsUsed != hudTextSlotsDrawn) {
+        hudTextBatch.clear();
+        for (int s = 0; s < HUD_TEXT_SLOT_COUNT; s++) {
+            if (slotsUsed & (1ull << s)) {
+                hudTextBatch.insert(hudTextBatch.end(), hudTextSlots[s].vertices.begin(), hudTextSlots[s].vertices.end());
+            }
+        }
+
+        if (hudTextBuffer == 0) {
+            glGenBuffers(1, &hudTextBuffer);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, hudTextBuffer);
+        glBufferData(GL_ARRAY_BUFFER, hudTextBatch.size() * sizeof(HudTextVertex), hudTextBatch.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        hudTextBatchDirty = false;
+        hudTextSlotsDrawn = slotsUsed;
+    }
+
+    beginHudDraw();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, hudAtlasTexture);
+
+    glBindBuffer(GL_ARRAY_BUFFER, hudTextBuffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(HudTextVertex), (const void*)offsetof(HudTextVertex, x));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(HudTextVertex), (const void*)offsetof(HudTextVertex, u));
+    glColorPointer(3, GL_FLOAT, sizeof(HudTextVertex), (const void*)offsetof(HudTextVertex, r));
+    glDrawArrays(GL_QUADS, 0, (GLsizei)hudTextBatch.size());
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_BLEND);
+    endHudDraw();
+}
+
+void drawTimer()
+{
+    PROFILE_SCOPE(PROFILE_DRAW_TIMER);
+
+    // Elapsed game time to the millisecond, from the ticks run (or the final time)
+    int totalMs = (int)(frameState.gameFinished ? frameState.finalTimeMs + 0.5 : frameState.tick * tickSeconds * 1000.0);
+    int minutes = totalMs / 60000;
+    int seconds = totalMs / 1000 % 60;
+    int millis = totalMs % 1000;
+    char timeString[64];
+    if (endlessMode) {
+        snprintf(timeString, sizeof(timeString), "Time: %02d:%02d.%03d  Distance: %lld", minutes, seconds, millis,
+                 (long long)endlessFurthestRow);
+    }
+    else if (showHints && hintStepsToGoal != SOLVER_UNREACHABLE) {
+        snprintf(timeString, sizeof(timeString), "Time: %02d:%02d.%03d  Steps to goal: %u", minutes, seconds, millis,
+                 hintStepsToGoal);
+    }
+    else {
+        snprintf(timeString, sizeof(timeString), "Time: %02d:%02d.%03d", minutes, seconds, millis);
+    }
+
+    // Draw timer text - only re-laid out when the string changes
+    hudText(HUD_TEXT_TIMER, 10, WINDOW_HEIGHT - 20, HUD_FONT_MEDIUM, 1.0f, 1.0f, 1.0f, timeString);
+}
+
 void drawInstructions()
 {
-    // Save current matrices
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
+    PROFILE_SCOPE(PROFILE_DRAW_INSTRUCTIONS);
+
+    // Line 1 - Changed from W/S to UP/DOWN
+    hudText(HUD_TEXT_HELP_1, 10, WINDOW_HEIGHT - 40, HUD_FONT_SMALL, 1.0f, 1.0f, 1.0f,
+            "UP/DOWN: Move forward/backward");
+
+    // Line 2 - Changed from A/D to LEFT/RIGHT
+    hudText(HUD_TEXT_HELP_2, 10, WINDOW_HEIGHT - 60, HUD_FONT_SMALL, 1.0f, 1.0f, 1.0f,
+            "LEFT/RIGHT: Turn left/right");
+
+    // Lines 3 and 4 - the toggles, split so they fit the window
+    hudText(HUD_TEXT_HELP_3, 10, WINDOW_HEIGHT - 80, HUD_FONT_SMALL, 1.0f, 1.0f, 1.0f,
+            "M: Toggle minimap | F: Fog | H: Hints | I: Stats | P: Profiler | ESC: Exit");
+    hudText(HUD_TEXT_HELP_4, 10, WINDOW_HEIGHT - 100, HUD_FONT_SMALL, 1.0f, 1.0f, 1.0f,
+            "B: Renderer | R: Raycast | C: Culling | V: PVS | L: Light | D: Resolution | T: Text");
+}
+
+void drawStats()
+{
+    PROFILE_SCOPE(PROFILE_DRAW_STATS);
+
+    // Draw call / triangle counter for the 3D scene
+    const char* mode = useRaycaster ? "Raycast"
+                     : !useBakedMesh ? "Per-cube"
+                     : !(useCulling || !mazeMeshBaked) ? "Baked mesh"
+                     : (pvsLoaded && usePvs) ? "PVS culled" : "Culled";
+    char statsString[128];
+    if (!useRaycaster && useBakedMesh && (useCulling || !mazeMeshBaked)) {
+        snprintf(statsString, sizeof(statsString), "%s: %d draw calls, %d triangles, %d visible cells",
+                 mode, frameDrawCalls, frameTriangles, (int)visibleCells.size());
+    }
+    else {
+        snprintf(statsString, sizeof(statsString), "%s: %d draw calls, %d triangles", mode, frameDrawCalls, frameTriangles);
+    }
+    hudText(HUD_TEXT_STATS, 10, 20, HUD_FONT_SMALL, 0.6f, 1.0f, 0.6f, statsString);
+
+    // CPU time of the previous frame, to compare the text paths
+    char frameString[96];
+    snprintf(frameString, sizeof(frameString), "Frame: %.2f ms CPU, text: %s", frameTimeMs,
+             useBatchedText ? "glyph atlas" : "glutBitmapCharacter");
+    hudText(HUD_TEXT_FRAME_TIME, 10, 36, HUD_FONT_SMALL, 0.6f, 1.0f, 0.6f, frameString);
+
+    // Frame pacing over the last few seconds
+    char pacingString[128];
+    snprintf(pacingString, sizeof(pacingString), "Frame interval p50 %.1f / p95 %.1f / p99 %.1f / max %.1f ms, %d Hz sim, %llu missed ticks",
+             frameIntervalPercentile(50.0f), frameIntervalPercentile(95.0f), frameIntervalPercentile(99.0f),
+             frameIntervalPercentile(100.0f), tickRate, (unsigned long long)frameState.missedTicks);
+    hudText(HUD_TEXT_FRAME_PACING, 10, 52, HUD_FONT_SMALL, 0.6f, 1.0f, 0.6f, pacingString);
+
+    // Dynamic resolution, with the cost of recent frames graphed above
+    char resolutionString[128];
+    if (frameBudgetMs > 0.0f) {
+        snprintf(resolutionString, sizeof(resolutionString), "Resolution %d%%: %dx%d of %dx%d%s, budget %.1f ms, cost %.2f ms (GPU %.2f)",
+                 (int)lroundf(100.0f * sceneWidth / viewWidth), sceneWidth, sceneHeight, viewWidth, viewHeight,
+                 useDynamicResolution ? "" : " (fixed)", frameBudgetMs, frameCosts[(frameCostNext + FRAME_INTERVAL_HISTORY - 1) % FRAME_INTERVAL_HISTORY],
+                 gpuFrameMs);
+    }
+    else {
+        snprintf(resolutionString, sizeof(resolutionString), "Resolution: full %dx%d, no frame budget, GPU %.2f ms",
+                 viewWidth, viewHeight, gpuFrameMs);
+    }
+    hudText(HUD_TEXT_RESOLUTION, 10, 68, HUD_FONT_SMALL, 0.6f, 1.0f, 0.6f, resolutionString);
+    drawFrameCostGraph();
+}
+
+// Cost of the last FRAME_INTERVAL_HISTORY frames as bars, red over the budget
+// (the dashed line), with the scale each was drawn at as a line over them
+void drawFrameCostGraph()
+{
+    const float graphX = 10.0f;
+    const float graphY = 80.0f;
+    const float graphHeight = 80.0f;
+    float rangeMs = (frameBudgetMs > 0.0f ? frameBudgetMs : DEFAULT_FRAME_BUDGET_MS) * 1.5f;
 
-    // Set up 2D orthographic projection for UI elements
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
     glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
     glLoadIdentity();
-    glOrtho(0, WINDOW_WIDTH, 0, WINDOW_HEIGHT, -1, 1);
+    gluOrtho2D(0, WINDOW_WIDTH, 0, WINDOW_HEIGHT);
     glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
     glLoadIdentity();
 
-    // Disable lighting for 2D elements
-    glDisable(GL_LIGHTING);
-    glDisable(GL_DEPTH_TEST);
-
-    // Draw instruction text
-    glColor3f(1.0f, 1.0f, 1.0f);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glColor4f(0.0f, 0.0f, 0.0f, 0.6f);
+    glBegin(GL_QUADS);
+    glVertex2f(graphX, graphY);
+    glVertex2f(graphX + FRAME_INTERVAL_HISTORY, graphY);
+    glVertex2f(graphX + FRAME_INTERVAL_HISTORY, graphY + graphHeight);
+    glVertex2f(graphX, graphY + graphHeight);
+    glEnd();
+    glDisable(GL_BLEND);
 
-    // Line 1 - Changed from W/S to UP/DOWN
-    glRasterPos2f(10, WINDOW_HEIGHT - 40);
-    const char* line1 = "UP/DOWN: Move forward/backward";
-    for (int i = 0; line1[i] != '\0'; i++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, line1[i]);
+    // Oldest frame on the left, one pixel column each
+    glLineWidth(1.0f);
+    int first = (frameCostNext - frameCostCount + FRAME_INTERVAL_HISTORY) % FRAME_INTERVAL_HISTORY;
+    glBegin(GL_LINES);
+    for (int f = 0; f < frameCostCount; f++) {
+        float cost = frameCosts[(first + f) % FRAME_INTERVAL_HISTORY];
+        if (frameBudgetMs > 0.0f && cost > frameBudgetMs) {
+            glColor3f(1.0f, 0.35f, 0.3f);
+        }
+        else {
+            glColor3f(0.4f, 0.8f, 0.4f);
+        }
+        float x = graphX + f + 0.5f;
+        glVertex2f(x, graphY);
+        glVertex2f(x, graphY + graphHeight * std::min(1.0f, cost / rangeMs));
     }
+    glEnd();
 
-    // Line 2 - Changed from A/D to LEFT/RIGHT
-    glRasterPos2f(10, WINDOW_HEIGHT - 60);
-    const char* line2 = "LEFT/RIGHT: Turn left/right";
-    for (int i = 0; line2[i] != '\0'; i++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, line2[i]);
+    glColor3f(0.3f, 0.7f, 1.0f);
+    glBegin(GL_LINE_STRIP);
+    for (int f = 0; f < frameCostCount; f++) {
+        glVertex2f(graphX + f + 0.5f, graphY + graphHeight * frameScales[(first + f) % FRAME_INTERVAL_HISTORY]);
     }
+    glEnd();
 
-    // Line 3
-    glRasterPos2f(10, WINDOW_HEIGHT - 80);
-    const char* line3 = "M: Toggle minimap | ESC: Exit";
-    for (int i = 0; line3[i] != '\0'; i++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, line3[i]);
+    if (frameBudgetMs > 0.0f) {
+        float budgetY = graphY + graphHeight / 1.5f;
+        glColor3f(1.0f, 1.0f, 1.0f);
+        glBegin(GL_LINES);
+        for (float x = graphX; x < graphX + FRAME_INTERVAL_HISTORY; x += 8.0f) {
+            glVertex2f(x, budgetY);
+            glVertex2f(x + 4.0f, budgetY);
+        }
+        glEnd();
     }
 
-    // Re-enable lighting and depth testing
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-
-    // Restore matrices
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
     glPopMatrix();
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
 }
 
-void drawCongratsMessage()
+// Average and worst time per frame of every profiled stage, plus calls per frame
+void drawProfiler()
 {
-    // Save current matrices and attributes
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
+    PROFILE_SCOPE(PROFILE_DRAW_PROFILER);
 
-    // Set up orthographic projection for 2D overlay
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, WINDOW_WIDTH, 0, WINDOW_HEIGHT, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    if (profileOverlayAge-- <= 0) {
+        profileOverlayAge = PROFILE_OVERLAY_REFRESH_FRAMES;
+        uint64_t dropped = 0;
+        for (ProfileRing& ring : profileRings) {
+            dropped += ring.dropped.load(std::memory_order_relaxed);
+        }
+        if (!PROFILER_COMPILED_IN) {
+            snprintf(profileOverlayLines[0], sizeof(profileOverlayLines[0]), "Profiler compiled out (MAZE_NO_PROFILER)");
+        }
+        else {
+            snprintf(profileOverlayLines[0], sizeof(profileOverlayLines[0]), "Profiler: avg / max ms per frame over %d frames, %llu dropped",
+                     profileFrameCount, (unsigned long long)dropped);
+        }
+        for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+            uint64_t totalNs = 0;
+            uint64_t maxNs = 0;
+            uint64_t calls = 0;
+            for (int f = 0; f < profileFrameCount; f++) {
+                totalNs += profileStageNs[f][stage];
+                maxNs = std::max(maxNs, profileStageNs[f][stage]);
+                calls += profileStageCalls[f][stage];
+            }
+            int frames = std::max(1, profileFrameCount);
+            snprintf(profileOverlayLines[stage + 1], sizeof(profileOverlayLines[0]), "%s: %.3f / %.3f ms, %.1f calls",
+                     profileStageNames[stage], totalNs / 1e6 / frames, maxNs / 1e6, (double)calls / frames);
+        }
+    }
 
-    // Disable lighting and depth testing
-    glDisable(GL_LIGHTING);
-    glDisable(GL_DEPTH_TEST);
+    int lines = PROFILER_COMPILED_IN ? PROFILE_STAGE_COUNT + 1 : 1;
+    for (int line = 0; line < lines; line++) {
+        hudText(HUD_TEXT_PROFILER + line, 10, WINDOW_HEIGHT - 125 - 15 * line, HUD_FONT_SMALL, 1.0f, 0.85f, 0.4f,
+                profileOverlayLines[line]);
+    }
+}
 
-    // Draw semi-transparent background
-    glColor4f(0.0f, 0.0f, 0.0f, 0.7f);
-    glBegin(GL_QUADS);
-    glVertex2f(0, 0);
-    glVertex2f(WINDOW_WIDTH, 0);
-    glVertex2f(WINDOW_WIDTH, WINDOW_HEIGHT);
-    glVertex2f(0, WINDOW_HEIGHT);
-    glEnd();
+void drawCongratsMessage()
+{
+    PROFILE_SCOPE(PROFILE_DRAW_CONGRATS);
 
-    // Convert completion time to string
-    int minutes = finalTime / 60;
-    int seconds = finalTime % 60;
-    char timeString[100];
-    snprintf(timeString, sizeof(timeString), "Time: %02d:%02d", minutes, seconds);
+    // Background over the whole window, under the text in the HUD batch
+    hudQuad(HUD_TEXT_CONGRATS_BACKGROUND, 0.0f, 0.0f, WINDOW_WIDTH, WINDOW_HEIGHT, 0.0f, 0.0f, 0.0f);
 
-    // Draw congratulations text
-    glColor3f(1.0f, 1.0f, 0.0f); // Yellow
+    // Convert completion time to string, to the millisecond
+    int totalMs = (int)(frameState.finalTimeMs + 0.5);
+    int minutes = totalMs / 60000;
+    int seconds = totalMs / 1000 % 60;
+    char timeString[100];
+    snprintf(timeString, sizeof(timeString), "Time: %02d:%02d.%03d", minutes, seconds, totalMs % 1000);
 
-    // Title
+    // Draw congratulations text in yellow, centred with the cached glyph widths
     const char* congratsTitle = "CONGRATULATIONS!";
-    int titleWidth = 0;
-    for (int i = 0; congratsTitle[i] != '\0'; i++) {
-        titleWidth += glutBitmapWidth(GLUT_BITMAP_TIMES_ROMAN_24, congratsTitle[i]);
-    }
-    glRasterPos2f((WINDOW_WIDTH - titleWidth) / 2, WINDOW_HEIGHT / 2 + 30);
-    for (int i = 0; congratsTitle[i] != '\0'; i++) {
-        glutBitmapCharacter(GLUT_BITMAP_TIMES_ROMAN_24, congratsTitle[i]);
-    }
+    hudText(HUD_TEXT_CONGRATS_TITLE, (WINDOW_WIDTH - hudTextWidth(HUD_FONT_LARGE, congratsTitle)) / 2, WINDOW_HEIGHT / 2 + 30,
+            HUD_FONT_LARGE, 1.0f, 1.0f, 0.0f, congratsTitle);
 
-    // Message
     const char* congratsMessage = "You successfully completed the maze!";
-    int messageWidth = 0;
-    for (int i = 0; congratsMessage[i] != '\0'; i++) {
-        messageWidth += glutBitmapWidth(GLUT_BITMAP_HELVETICA_18, congratsMessage[i]);
-    }
-    glRasterPos2f((WINDOW_WIDTH - messageWidth) / 2, WINDOW_HEIGHT / 2);
-    for (int i = 0; congratsMessage[i] != '\0'; i++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, congratsMessage[i]);
-    }
+    hudText(HUD_TEXT_CONGRATS_MESSAGE, (WINDOW_WIDTH - hudTextWidth(HUD_FONT_MEDIUM, congratsMessage)) / 2, WINDOW_HEIGHT / 2,
+            HUD_FONT_MEDIUM, 1.0f, 1.0f, 0.0f, congratsMessage);
 
-    // Time
-    int timeWidth = 0;
-    for (int i = 0; timeString[i] != '\0'; i++) {
-        timeWidth += glutBitmapWidth(GLUT_BITMAP_HELVETICA_18, timeString[i]);
-    }
-    glRasterPos2f((WINDOW_WIDTH - timeWidth) / 2, WINDOW_HEIGHT / 2 - 30);
-    for (int i = 0; timeString[i] != '\0'; i++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_18, timeString[i]);
-    }
+    hudText(HUD_TEXT_CONGRATS_TIME, (WINDOW_WIDTH - hudTextWidth(HUD_FONT_MEDIUM, timeString)) / 2, WINDOW_HEIGHT / 2 - 30,
+            HUD_FONT_MEDIUM, 1.0f, 1.0f, 0.0f, timeString);
 
-    // Continue message
-    const char* continueMessage = "Press SPACE to continue";
-    int continueWidth = 0;
-    for (int i = 0; continueMessage[i] != '\0'; i++) {
-        continueWidth += glutBitmapWidth(GLUT_BITMAP_HELVETICA_12, continueMessage[i]);
+    // The next level is normally built long before this, but a big one may not be
+    char continueMessage[100] = "";
+    if (nextLevel && nextLevel->jobs->finished()) {
+        snprintf(continueMessage, sizeof(continueMessage), "Press SPACE for level %d", nextLevel->number);
     }
-    glRasterPos2f((WINDOW_WIDTH - continueWidth) / 2, WINDOW_HEIGHT / 2 - 70);
-    for (int i = 0; continueMessage[i] != '\0'; i++) {
-        glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12, continueMessage[i]);
+    else if (nextLevel) {
+        snprintf(continueMessage, sizeof(continueMessage), "%s level %d... (%d/%d)", levelRequested ? "Starting" : "Building",
+                 nextLevel->number, nextLevel->jobs->completedCount(), nextLevel->jobs->jobCount());
     }
-
-    // Re-enable disabled states
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-
-    // Restore matrices
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
+    hudText(HUD_TEXT_CONGRATS_CONTINUE, (WINDOW_WIDTH - hudTextWidth(HUD_FONT_SMALL, continueMessage)) / 2, WINDOW_HEIGHT / 2 - 70,
+            HUD_FONT_SMALL, 1.0f, 1.0f, 0.0f, continueMessage);
 }
 
-void drawText(float x, float y, const char* text)
+// Shown until the first level is ready: the difficulty menu when none was given
+// on the command line, then the progress of the level build
+void drawLoadingScreen()
 {
-    // Save current matrices and attributes
+    // Save current matrices and set up a 2D overlay
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-
-    // Set up orthographic projection
-    glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
-    gluOrtho2D(-1.0, 1.0, -1.0, 1.0);
+    glOrtho(0, WINDOW_WIDTH, 0, WINDOW_HEIGHT, -1, 1);
     glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
     glLoadIdentity();
-
-    // Disable lighting
     glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
 
-    // Draw text
-    glColor3f(1.0f, 1.0f, 0.0f);
-    glRasterPos2f(x, y);
-    for (int i = 0; text[i] != '\0'; i++) {
-        glutBitmapCharacter(GLUT_BITMAP_TIMES_ROMAN_24, text[i]);
+    if (!nextLevel) {
+        const char* title = "Select difficulty";
+        hudText(HUD_TEXT_LOADING_TITLE, (WINDOW_WIDTH - hudTextWidth(HUD_FONT_LARGE, title)) / 2, WINDOW_HEIGHT / 2 + 60,
+                HUD_FONT_LARGE, 1.0f, 1.0f, 0.0f, title);
+        const char* names[DIFFICULTY_HARD] = { "Easy", "Medium", "Hard" };
+        for (int difficulty = DIFFICULTY_EASY; difficulty <= DIFFICULTY_HARD; difficulty++) {
+            char line[64];
+            int size = mazeSizeForDifficulty(difficulty);
+            snprintf(line, sizeof(line), "%d. %s (%dx%d maze)", difficulty, names[difficulty - 1], size, size);
+            hudText(HUD_TEXT_DIFFICULTY + difficulty - 1, WINDOW_WIDTH / 2 - 90, WINDOW_HEIGHT / 2 + 10 - 30 * difficulty,
+                    HUD_FONT_MEDIUM, 1.0f, 1.0f, 1.0f, line);
+        }
+    }
+    else {
+        char title[64];
+        snprintf(title, sizeof(title), "Building level %d", nextLevel->number);
+        hudText(HUD_TEXT_LOADING_TITLE, (WINDOW_WIDTH - hudTextWidth(HUD_FONT_LARGE, title)) / 2, WINDOW_HEIGHT / 2 + 30,
+                HUD_FONT_LARGE, 1.0f, 1.0f, 0.0f, title);
+
+        char status[64];
+        snprintf(status, sizeof(status), "%dx%d maze, %d of %d steps done", nextLevel->size, nextLevel->size,
+                 nextLevel->jobs->completedCount(), nextLevel->jobs->jobCount());
+        hudText(HUD_TEXT_LOADING_STATUS, (WINDOW_WIDTH - hudTextWidth(HUD_FONT_SMALL, status)) / 2, WINDOW_HEIGHT / 2 - 40,
+                HUD_FONT_SMALL, 1.0f, 1.0f, 1.0f, status);
+
+        // Progress bar
+        float progress = (float)nextLevel->jobs->completedCount() / std::max(1, nextLevel->jobs->jobCount());
+        float x0 = WINDOW_WIDTH / 2 - 150.0f;
+        float y0 = WINDOW_HEIGHT / 2 - 15.0f;
+        glColor3f(0.3f, 0.3f, 0.3f);
+        glBegin(GL_QUADS);
+        glVertex2f(x0, y0);
+        glVertex2f(x0 + 300.0f, y0);
+        glVertex2f(x0 + 300.0f, y0 + 12.0f);
+        glVertex2f(x0, y0 + 12.0f);
+        glColor3f(0.5f, 0.5f, 0.7f);
+        glVertex2f(x0, y0);
+        glVertex2f(x0 + 300.0f * progress, y0);
+        glVertex2f(x0 + 300.0f * progress, y0 + 12.0f);
+        glVertex2f(x0, y0 + 12.0f);
+        glEnd();
     }
 
-    // Re-enable lighting
+    // Restore states and matrices
+    glEnable(GL_DEPTH_TEST);
     glEnable(GL_LIGHTING);
-
-    // Restore matrices
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
     glPopMatrix();
 }
 
-bool checkCollision(float x, float y, float z)
+// Yellow Times Roman text at (x, y) in [-1, 1] screen coordinates
+void drawText(float x, float y, const char* text)
 {
-    // Calculate grid cell coordinates
-    int gridX = (int)(x + 0.5f);
-    int gridZ = (int)(z + 0.5f);
-
-    // Check if out of bounds
-    if (gridX < 0 || gridX >= MAZE_SIZE + 2 || gridZ < 0 || gridZ >= MAZE_SIZE + 2) {
-        return true;
-    }
-
-    // Check collision with wall
-    if (maze[gridX][gridZ] == 1) {
-        return true;
-    }
-
-    // Allow movement in empty space
-    return false;
+    hudText(HUD_TEXT_CUSTOM, (x + 1.0f) * 0.5f * WINDOW_WIDTH, (y + 1.0f) * 0.5f * WINDOW_HEIGHT,
+            HUD_FONT_LARGE, 1.0f, 1.0f, 0.0f, text);
 }
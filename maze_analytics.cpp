@@ -0,0 +1,284 @@
+// Batch maze analytics for tuning the difficulty presets. Generates --count
+// seeded mazes for every combination of --sizes and --openings (the percent of
+// extra wall openings, 30 in the game) and measures each one with
+// measureMaze(): solution length, dead ends, junctions, decision points on the
+// solution, loops and branching factor.
+//
+//   maze_analytics [--count N] [--sizes 10,15,20] [--openings 0,15,30] [--seed N]
+//                  [--threads N] [--format csv|bin] [--output FILE]
+//
+// Maze i of every combination uses seed + i, so the combinations can be compared
+// maze by maze. The mazes are generated in row groups of ANALYTICS_GROUP_ROWS on
+// a work-stealing pool, ANALYTICS_JOB_MAZES per job, and every group is written
+// out in order before the next one starts, so memory stays flat however many
+// mazes are asked for. Rows go to stdout (or --output) as CSV, or as a columnar
+// binary file with --format bin:
+//
+//   "MZAN", u32 version, u32 column count, then per column u8 type (0 = u32,
+//   1 = f32), u8 name length and the name;
+//   row groups: u32 row count, then each column's values for those rows in turn;
+//   a row group of 0 rows ends the file.
+//
+// Everything is little-endian. The mean and standard deviation of every metric
+// per combination and the mazes per second go to stderr.
+#include "maze_core.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+const int ANALYTICS_GROUP_ROWS = 65536;
+const int ANALYTICS_JOB_MAZES = 64;
+const uint32_t ANALYTICS_FORMAT_VERSION = 1;
+
+// One row: the maze's parameters and its metrics
+struct AnalyticsRow {
+    uint32_t size = 0;
+    uint32_t openings = 0;
+    uint32_t seed = 0;
+    MazeMetrics metrics;
+};
+
+const int ANALYTICS_COLUMNS = 10;
+const char* const analyticsColumnNames[ANALYTICS_COLUMNS] = {
+    "size", "openings", "seed", "open_cells", "solution_length", "dead_ends",
+    "junctions", "decision_points", "loops", "branching_factor"
+};
+
+static uint32_t columnValue(const AnalyticsRow& row, int column)
+{
+    switch (column) {
+    case 0: return row.size;
+    case 1: return row.openings;
+    case 2: return row.seed;
+    case 3: return row.metrics.openCells;
+    case 4: return row.metrics.solutionLength;
+    case 5: return row.metrics.deadEnds;
+    case 6: return row.metrics.junctions;
+    case 7: return row.metrics.decisionPoints;
+    default: return row.metrics.loops;
+    }
+}
+
+// Running mean and variance of the metrics of one combination (Welford). The
+// branching factor (metric 6) is the mean exits of a junction, so mazes without
+// junctions have none and are only counted, not averaged in as 0.
+struct MetricSummary {
+    uint64_t count[7] = {};
+    uint64_t unsolvable = 0;
+    uint64_t noJunctions = 0;
+    double mean[7] = {};
+    double m2[7] = {};
+
+    void add(const AnalyticsRow& row)
+    {
+        if (row.metrics.solutionLength == SOLVER_UNREACHABLE) {
+            unsolvable++;
+            return;
+        }
+        if (row.metrics.junctions == 0) {
+            noJunctions++;
+        }
+        for (int m = 0; m < 7; m++) {
+            if (m == 6 && row.metrics.junctions == 0) {
+                continue;
+            }
+            double value = m < 6 ? columnValue(row, 3 + m) : row.metrics.branchingFactor;
+            double delta = value - mean[m];
+            count[m]++;
+            mean[m] += delta / count[m];
+            m2[m] += delta * (value - mean[m]);
+        }
+    }
+
+    double deviation(int m) const { return count[m] > 1 ? sqrt(m2[m] / (count[m] - 1)) : 0.0; }
+};
+
+static void writeHeader(FILE* out, bool binary)
+{
+    if (!binary) {
+        for (int c = 0; c < ANALYTICS_COLUMNS; c++) {
+            fprintf(out, c ? ",%s" : "%s", analyticsColumnNames[c]);
+        }
+        fprintf(out, "\n");
+        return;
+    }
+
+    uint32_t fields[2] = { ANALYTICS_FORMAT_VERSION, ANALYTICS_COLUMNS };
+    fwrite("MZAN", 1, 4, out);
+    fwrite(fields, sizeof(uint32_t), 2, out);
+    for (int c = 0; c < ANALYTICS_COLUMNS; c++) {
+        uint8_t type = c == ANALYTICS_COLUMNS - 1 ? 1 : 0;
+        uint8_t length = (uint8_t)strlen(analyticsColumnNames[c]);
+        fwrite(&type, 1, 1, out);
+        fwrite(&length, 1, 1, out);
+        fwrite(analyticsColumnNames[c], 1, length, out);
+    }
+}
+
+static void writeGroup(FILE* out, bool binary, const std::vector<AnalyticsRow>& rows, size_t count)
+{
+    if (!binary) {
+        for (size_t r = 0; r < count; r++) {
+            const AnalyticsRow& row = rows[r];
+            const MazeMetrics& m = row.metrics;
+            fprintf(out, "%u,%u,%u,%u,%lld,%u,%u,%u,%u,%.4f\n", row.size, row.openings, row.seed, m.openCells,
+                    m.solutionLength == SOLVER_UNREACHABLE ? -1LL : (long long)m.solutionLength, m.deadEnds,
+                    m.junctions, m.decisionPoints, m.loops, m.branchingFactor);
+        }
+        return;
+    }
+
+    // Columns are gathered one at a time into a buffer so each goes out in one write
+    uint32_t rowCount = (uint32_t)count;
+    fwrite(&rowCount, sizeof(rowCount), 1, out);
+    std::vector<uint32_t> column(count);
+    for (int c = 0; c < ANALYTICS_COLUMNS - 1; c++) {
+        for (size_t r = 0; r < count; r++) {
+            column[r] = columnValue(rows[r], c);
+        }
+        fwrite(column.data(), sizeof(uint32_t), count, out);
+    }
+    std::vector<float> branching(count);
+    for (size_t r = 0; r < count; r++) {
+        branching[r] = rows[r].metrics.branchingFactor;
+    }
+    fwrite(branching.data(), sizeof(float), count, out);
+}
+
+int main(int argc, char** argv)
+{
+    long long count = 1000;
+    std::vector<int> sizes = { 10, 15, 20 };
+    std::vector<int> openings = { 0, 15, EXTRA_OPENING_PERCENT };
+    unsigned int seed = 1;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool binary = false;
+    std::string outputPath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            count = std::max(1LL, atoll(argv[++i]));
+        }
+        else if (arg == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            for (char* token = strtok(argv[++i], ","); token; token = strtok(NULL, ",")) {
+                sizes.push_back(std::max(2, atoi(token)));
+            }
+        }
+        else if (arg == "--openings" && i + 1 < argc) {
+            openings.clear();
+            for (char* token = strtok(argv[++i], ","); token; token = strtok(NULL, ",")) {
+                openings.push_back(std::max(0, std::min(100, atoi(token))));
+            }
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            threads = (unsigned)std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--format" && i + 1 < argc) {
+            binary = std::string(argv[++i]) == "bin";
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 1;
+        }
+    }
+    if (sizes.empty() || openings.empty()) {
+        fprintf(stderr, "--sizes and --openings need at least one value\n");
+        return 1;
+    }
+
+    FILE* out = stdout;
+    if (!outputPath.empty()) {
+        out = fopen(outputPath.c_str(), binary ? "wb" : "w");
+        if (!out) {
+            fprintf(stderr, "Could not write %s\n", outputPath.c_str());
+            return 1;
+        }
+    }
+    else if (binary) {
+        fprintf(stderr, "--format bin needs --output FILE\n");
+        return 1;
+    }
+
+    // Rows are numbered combination by combination, seed by seed
+    int combinations = (int)(sizes.size() * openings.size());
+    long long totalRows = count * combinations;
+    std::vector<MetricSummary> summaries(combinations);
+    std::vector<AnalyticsRow> rows(ANALYTICS_GROUP_ROWS);
+    WorkStealingPool pool(threads);
+    fprintf(stderr, "Measuring %lld mazes (%d combinations x %lld seeds from %u) on %u thread(s)\n", totalRows,
+            combinations, count, seed, pool.threadCount());
+
+    writeHeader(out, binary);
+    auto startTime = std::chrono::steady_clock::now();
+    for (long long first = 0; first < totalRows; first += ANALYTICS_GROUP_ROWS) {
+        int groupRows = (int)std::min<long long>(ANALYTICS_GROUP_ROWS, totalRows - first);
+        int jobs = (groupRows + ANALYTICS_JOB_MAZES - 1) / ANALYTICS_JOB_MAZES;
+        pool.run(jobs, [&](int job) {
+            // Each thread keeps its grid and solver buffers from maze to maze
+            thread_local MazeGrid grid;
+            thread_local MazeSolver scratch;
+            int end = std::min(groupRows, (job + 1) * ANALYTICS_JOB_MAZES);
+            for (int r = job * ANALYTICS_JOB_MAZES; r < end; r++) {
+                long long index = first + r;
+                int combination = (int)(index / count);
+                AnalyticsRow& row = rows[r];
+                row.size = (uint32_t)sizes[combination / openings.size()];
+                row.openings = (uint32_t)openings[combination % openings.size()];
+                row.seed = seed + (uint32_t)(index % count);
+                generateMazeGrid(grid, (int)row.size, row.seed, GENERATOR_DFS, (int)row.openings);
+                row.metrics = measureMaze(grid, scratch);
+            }
+        });
+
+        for (int r = 0; r < groupRows; r++) {
+            summaries[(first + r) / count].add(rows[r]);
+        }
+        writeGroup(out, binary, rows, groupRows);
+    }
+    if (binary) {
+        writeGroup(out, binary, rows, 0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "%6s %8s %16s %14s %14s %14s %14s %12s\n", "size", "openings", "solution", "dead ends",
+            "junctions", "decisions", "loops", "branching");
+    for (int c = 0; c < combinations; c++) {
+        const MetricSummary& s = summaries[c];
+        fprintf(stderr, "%6d %7d%% %8.1f +-%5.1f %7.1f +-%4.1f %7.1f +-%4.1f %7.1f +-%4.1f %7.1f +-%4.1f",
+                sizes[c / openings.size()], openings[c % openings.size()], s.mean[1], s.deviation(1), s.mean[2],
+                s.deviation(2), s.mean[3], s.deviation(3), s.mean[4], s.deviation(4), s.mean[5], s.deviation(5));
+        if (s.count[6] > 0) {
+            fprintf(stderr, " %6.3f +-%.2f", s.mean[6], s.deviation(6));
+        }
+        else {
+            fprintf(stderr, " %12s", "-");
+        }
+        if (s.unsolvable > 0) {
+            fprintf(stderr, "  (%llu unsolvable)", (unsigned long long)s.unsolvable);
+        }
+        if (s.noJunctions > 0) {
+            fprintf(stderr, "  (%llu without junctions)", (unsigned long long)s.noJunctions);
+        }
+        fprintf(stderr, "\n");
+    }
+    fprintf(stderr, "%lld mazes in %.2f s: %.0f mazes/s, %.0f per thread\n", totalRows, seconds, totalRows / seconds,
+            totalRows / seconds / pool.threadCount());
+    return 0;
+}
@@ -0,0 +1,559 @@
+// Benchmarks for the maze core (maze_core.cpp): maze generation, collision,
+// movement, the lighting bake, the solvers, the software raycaster, input
+// replay and agents, over maze sizes from 10 up to 8192.
+// Results are written as JSON or CSV, and "--baseline FILE" compares them
+// against an earlier run and fails when a case got slower by more than the
+// threshold.
+//
+//   maze_bench [--sizes 10,15,20,...] [--repeats N] [--filter TEXT] [--seed N]
+//              [--format json|csv] [--output FILE] [--baseline FILE] [--threshold PCT]
+//
+// Results go to stdout (or --output), progress and the comparison to stderr.
+// The exit code is 1 when the comparison found a regression and 2 when the
+// flood fills and the solvers disagreed about the maze, a replay didn't end
+// where its recording did, an agent ended up inside a wall or a swept circle
+// didn't end where it should.
+#include "maze_core.h"
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+// One timed case at one maze size. Times are per operation - one maze, one
+// collision test, one movement tick, one search.
+struct BenchResult {
+    std::string name;
+    int size = 0;
+    long long iterations = 0;   // calls of the case per timed run
+    int runs = 0;
+    double medianNs = 0.0;
+    double minNs = 0.0;
+};
+
+const double BENCH_MIN_RUN_MS = 5.0;     // calls are batched until a run takes at least this long
+const double BENCH_CASE_BUDGET_MS = 1000.0;
+const int BENCH_MIN_RUNS = 3;
+
+std::vector<BenchResult> results;
+std::string benchFilter;
+int benchRepeats = 5;
+
+static double elapsedMs(std::chrono::steady_clock::time_point startTime)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// Time run() (which does opsPerCall operations): first find how many calls make
+// a run of at least BENCH_MIN_RUN_MS, then time up to benchRepeats such runs
+// (at least BENCH_MIN_RUNS, fewer once the case has used its time budget)
+static void benchCase(const char* name, int size, double opsPerCall, const std::function<void()>& run)
+{
+    if (!benchFilter.empty() && strstr(name, benchFilter.c_str()) == NULL) {
+        return;
+    }
+
+    long long iterations = 1;
+    double caseMs = 0.0;
+    while (true) {
+        auto startTime = std::chrono::steady_clock::now();
+        for (long long i = 0; i < iterations; i++) {
+            run();
+        }
+        double runMs = elapsedMs(startTime);
+        caseMs += runMs;
+        if (runMs >= BENCH_MIN_RUN_MS) {
+            break;
+        }
+        iterations *= runMs < BENCH_MIN_RUN_MS / 16 ? 8 : 2;
+    }
+
+    std::vector<double> times;
+    while ((int)times.size() < benchRepeats && ((int)times.size() < BENCH_MIN_RUNS || caseMs < BENCH_CASE_BUDGET_MS)) {
+        auto startTime = std::chrono::steady_clock::now();
+        for (long long i = 0; i < iterations; i++) {
+            run();
+        }
+        double runMs = elapsedMs(startTime);
+        caseMs += runMs;
+        times.push_back(runMs * 1e6 / (iterations * opsPerCall));
+    }
+    std::sort(times.begin(), times.end());
+
+    BenchResult result;
+    result.name = name;
+    result.size = size;
+    result.iterations = iterations;
+    result.runs = (int)times.size();
+    result.medianNs = times[times.size() / 2];
+    result.minNs = times[0];
+    results.push_back(result);
+    fprintf(stderr, "  %-18s %6d  %14.1f ns/op  (min %.1f, %d runs of %lld)\n", name, size, result.medianNs, result.minNs,
+            result.runs, iterations);
+}
+
+// Record a session of the given length on the current maze: an autopilot walks
+// the distance field to the goal, turning on the spot and then walking, and
+// once there dismisses the message and wanders with random controls. Only
+// control changes are events, as they would be from a keyboard.
+static void recordAutopilotSession(uint64_t ticks, unsigned int seed)
+{
+    playerX = prevPlayerX = 1.0f;
+    playerZ = prevPlayerZ = 1.0f;
+    playerAngle = prevPlayerAngle = 90.0f;
+    std::fill(controlStates, controlStates + CONTROL_COUNT, false);
+    gameFinished = false;
+    showCongratsMessage = false;
+    finishTick = 0;
+    simTick = 0;
+    buildDistanceField(MAZE_SIZE, MAZE_SIZE);
+    startRecording(0);
+
+    std::mt19937 rng(seed);
+    std::vector<int> path;
+    bool wanted[CONTROL_COUNT] = { false };
+    while (simTick < ticks) {
+        std::fill(wanted, wanted + CONTROL_COUNT, false);
+        if (showCongratsMessage) {
+            applyInputEvent({ (uint8_t)INPUT_DISMISS_CONGRATS, 0 });
+        }
+        else if (gameFinished) {
+            if (simTick % 32 == 0) {
+                uint32_t pattern = rng();
+                for (int c = 0; c < CONTROL_COUNT; c++) {
+                    wanted[c] = (pattern >> c) & 1;
+                }
+            }
+            else {
+                std::copy(controlStates, controlStates + CONTROL_COUNT, wanted);
+            }
+        }
+        else {
+            // Head for the centre of the next cell on the way to the goal
+            int cellX = (int)floor(playerX + 0.5f);
+            int cellZ = (int)floor(playerZ + 0.5f);
+            int next = followDistanceField(cellX, cellZ, 1, path) && path.size() > 1 ? path[1] : path.empty() ? -1 : path[0];
+            if (next >= 0) {
+                float dx = (float)(next % maze.width()) - playerX;
+                float dz = (float)(next / maze.width()) - playerZ;
+                float turn = atan2f(dx, -dz) * 180.0f / (float)M_PI - playerAngle;
+                turn -= 360.0f * floorf((turn + 180.0f) / 360.0f);
+                if (fabsf(turn) > 3.0f) {
+                    wanted[turn < 0.0f ? CONTROL_TURN_LEFT : CONTROL_TURN_RIGHT] = true;
+                }
+                else {
+                    wanted[CONTROL_FORWARD] = true;
+                }
+            }
+        }
+
+        for (int c = 0; c < CONTROL_COUNT; c++) {
+            if (wanted[c] != controlStates[c]) {
+                applyInputEvent({ (uint8_t)(wanted[c] ? INPUT_CONTROL_DOWN : INPUT_CONTROL_UP), (uint8_t)c });
+            }
+        }
+        simulationStep();
+    }
+    finishRecording();
+}
+
+// Swept collision against hand-made rooms, with where each move has to end:
+// sliding along a wall, stopping in a corner, going round a wall's corner and
+// moves far longer than the walls are thick
+static bool checkCollisionCases()
+{
+    struct CollisionCase {
+        const char* name;
+        int wallX, wallZ0, wallZ1;      // extra wall cells (wallX, wallZ0 .. wallZ1), none when wallX is 0
+        float x, z, moveX, moveZ;
+        float endX, endZ;               // where it has to end, endX < 0 for "anywhere past z = endZ"
+    };
+    const float edge = 0.5f + PLAYER_RADIUS;
+    const CollisionCase cases[] = {
+        { "slide along a wall", 0, 0, 0, 4.0f, 4.0f, -10.0f, 1.0f, edge, 5.0f },
+        { "into a corner", 0, 0, 0, 4.0f, 4.0f, -10.0f, -10.0f, edge, edge },
+        { "round a corner", 4, 4, 4, 2.0f, 2.2f, 4.0f, 4.0f, -1.0f, 5.0f },
+        { "fast into a wall", 4, 1, 7, 2.0f, 4.0f, 1000.0f, 0.0f, 3.5f - PLAYER_RADIUS, 4.0f },
+        { "fast along a wall", 4, 1, 7, 2.0f, 4.0f, 1000.0f, 400.0f, 3.5f - PLAYER_RADIUS, 7.5f - PLAYER_RADIUS },
+    };
+
+    bool passed = true;
+    for (const CollisionCase& test : cases) {
+        // A 7x7 room inside the border walls
+        MazeGrid room;
+        room.resize(9, 9, true);
+        for (int z = 1; z <= 7; z++) {
+            for (int x = 1; x <= 7; x++) {
+                room.setOpen(x, z);
+            }
+        }
+        for (int z = test.wallZ0; test.wallX > 0 && z <= test.wallZ1; z++) {
+            room.setWall(test.wallX, z);
+        }
+
+        float x = test.x;
+        float z = test.z;
+        moveCircle(room, PLAYER_RADIUS, x, z, test.moveX, test.moveZ);
+        bool ended = test.endX < 0.0f ? z > test.endZ : fabsf(x - test.endX) < 1e-3f && fabsf(z - test.endZ) < 1e-3f;
+        if (!ended || circleHitsWall(room, x, z, PLAYER_RADIUS * 0.999f)) {
+            fprintf(stderr, "  COLLISION CASE FAILED: %s ended at %.4f, %.4f\n", test.name, x, z);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+// Every case on one maze size. Returns false when the cross-checks between the
+// flood fills and the queue BFS / A* failed.
+static bool benchSize(int size, unsigned int seed)
+{
+    bool consistent = true;
+
+    benchCase("generate", size, 1.0, [&]() { generateMaze(size, seed, -1); });
+    generateMaze(size, seed, -1);
+
+    // Collision tests at random points spread over the maze
+    const int COLLISION_POINTS = 4096;
+    std::vector<float> pointX(COLLISION_POINTS);
+    std::vector<float> pointZ(COLLISION_POINTS);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> coordinate(0.0f, (float)size + 1.0f);
+    for (int i = 0; i < COLLISION_POINTS; i++) {
+        pointX[i] = coordinate(rng);
+        pointZ[i] = coordinate(rng);
+    }
+    volatile int collisions = 0;
+    benchCase("check_collision", size, COLLISION_POINTS, [&]() {
+        int hits = 0;
+        for (int i = 0; i < COLLISION_POINTS; i++) {
+            hits += checkCollision(pointX[i], 0.5f, pointZ[i]);
+        }
+        collisions = collisions + hits;
+    });
+
+    // Movement ticks with the controls changing every 32 ticks, as if someone
+    // were walking the maze (with every collision that comes with it)
+    const int MOVEMENT_TICKS = 1024;
+    std::vector<uint8_t> controls(MOVEMENT_TICKS / 32);
+    for (uint8_t& pattern : controls) {
+        pattern = (uint8_t)(rng() & 15);
+    }
+    playerX = playerZ = 1.0f;
+    playerAngle = 0.0f;
+    benchCase("process_movement", size, MOVEMENT_TICKS, [&]() {
+        for (int t = 0; t < MOVEMENT_TICKS; t++) {
+            uint8_t pattern = controls[t / 32];
+            for (int c = 0; c < CONTROL_COUNT; c++) {
+                controlStates[c] = (pattern >> c) & 1;
+            }
+            processMovement((float)tickSeconds);
+        }
+    });
+    std::fill(controlStates, controlStates + CONTROL_COUNT, false);
+
+    // Swept circle collision of a batch of player-sized circles, each moving up
+    // to a quarter of a cell a call (ten ticks at the game's speed) in its own
+    // direction, one op being one circle moved. The same circles then take
+    // moves of up to 50 cells, and none of them may end up in a wall or in
+    // another part of the maze.
+    if (benchFilter.empty() || strstr("sweep_circles", benchFilter.c_str()) != NULL) {
+        const int SWEEP_CIRCLES = 4096;
+        std::vector<float> circleX(SWEEP_CIRCLES), circleZ(SWEEP_CIRCLES);
+        std::vector<float> moveX(SWEEP_CIRCLES), moveZ(SWEEP_CIRCLES);
+        std::vector<uint32_t> circleLabels;
+        floodComponents(maze, circleLabels);
+        std::uniform_int_distribution<int> cell(1, size);
+        std::uniform_real_distribution<float> direction(0.0f, 2.0f * (float)M_PI);
+        std::uniform_real_distribution<float> length(0.0f, 0.25f);
+        for (int i = 0; i < SWEEP_CIRCLES; i++) {
+            int x, z;
+            do {
+                x = cell(rng);
+                z = cell(rng);
+            } while (maze.isWall(x, z));
+            circleX[i] = (float)x;
+            circleZ[i] = (float)z;
+            float angle = direction(rng);
+            float distance = length(rng);
+            moveX[i] = cosf(angle) * distance;
+            moveZ[i] = sinf(angle) * distance;
+        }
+        std::vector<uint32_t> startLabels(SWEEP_CIRCLES);
+        for (int i = 0; i < SWEEP_CIRCLES; i++) {
+            startLabels[i] = circleLabels[(size_t)circleZ[i] * maze.width() + (size_t)circleX[i]];
+        }
+        benchCase("sweep_circles", size, SWEEP_CIRCLES, [&]() {
+            sweepCircles(maze, PLAYER_RADIUS, SWEEP_CIRCLES, circleX.data(), circleZ.data(), moveX.data(), moveZ.data());
+        });
+        for (int i = 0; i < SWEEP_CIRCLES; i++) {
+            moveX[i] *= 200.0f;
+            moveZ[i] *= 200.0f;
+        }
+        sweepCircles(maze, PLAYER_RADIUS, SWEEP_CIRCLES, circleX.data(), circleZ.data(), moveX.data(), moveZ.data());
+        for (int i = 0; i < SWEEP_CIRCLES; i++) {
+            size_t endCell = (size_t)(int)(circleZ[i] + 0.5f) * maze.width() + (size_t)(int)(circleX[i] + 0.5f);
+            if (circleHitsWall(maze, circleX[i], circleZ[i], PLAYER_RADIUS * 0.999f) || circleLabels[endCell] != startLabels[i]) {
+                fprintf(stderr, "  CIRCLE GOT INTO A WALL on the %dx%d maze at %.3f, %.3f\n", size, size, circleX[i], circleZ[i]);
+                consistent = false;
+                break;
+            }
+        }
+    }
+
+    // Lighting bake of the GL renderer (ambient occlusion and lanterns), on the worker pool
+    if (size <= MAX_LIGHT_BAKE_SIZE) {
+        MazeLighting lighting;
+        benchCase("light_bake", size, 1.0, [&]() { bakeLighting(maze, seed, lighting); });
+    }
+
+    // Solvers, all between the start (1, 1) and the goal (size, size)
+    size_t fieldReached = 0;
+    benchCase("distance_field", size, 1.0, [&]() { fieldReached = buildDistanceField(size, size); });
+
+    std::vector<int> path;
+    bool pathFound = false;
+    benchCase("astar", size, 1.0, [&]() { pathFound = findPath(1, 1, size, size, path); });
+
+    std::vector<uint64_t> reached;
+    benchCase("flood_reachable", size, 1.0, [&]() { floodReachable(maze, size, size, reached); });
+
+    std::vector<uint32_t> layers;
+    benchCase("flood_layers", size, 1.0, [&]() { floodLayers(maze, size, size, layers); });
+
+    uint32_t goalDistance = 0;
+    benchCase("flood_distance", size, 1.0, [&]() { goalDistance = floodDistance(maze, 1, 1, size, size); });
+
+    std::vector<uint32_t> labels;
+    benchCase("flood_components", size, 1.0, [&]() { floodComponents(maze, labels); });
+
+    // Every solver has to agree with the queue BFS field (for the cases that ran)
+    if (!solver.distance.empty()) {
+        uint32_t fieldDistance = solver.distance[(size_t)1 * maze.width() + 1];
+        size_t floodReached = 0;
+        for (uint64_t bits : reached) {
+            floodReached += __builtin_popcountll(bits);
+        }
+        if ((!reached.empty() && floodReached != fieldReached)
+            || (!layers.empty() && layers != solver.distance)
+            || (goalDistance != 0 && goalDistance != fieldDistance)
+            || (!path.empty() && (!pathFound || path.size() - 1 != fieldDistance))) {
+            fprintf(stderr, "  MISMATCH between the solvers on the %dx%d maze\n", size, size);
+            consistent = false;
+        }
+    }
+
+    // Software raycaster at 1080p: one frame per op, from eight headings around
+    // the start cell (one op = one frame, rays and row fill on the worker pool)
+    RaycastFrame raycast;
+    int heading = 0;
+    benchCase("raycast_1080p", size, 1.0, [&]() {
+        raycastFrame(maze, 1.0f, 1.0f, 45.0f * (heading++ & 7), 0.5f, 1920, 1080, raycast);
+    });
+
+    // Replay a million recorded ticks headless - movement and collision with
+    // the input decoding around them - and check it ends where the recording did
+    if (benchFilter.empty() || strstr("replay", benchFilter.c_str()) != NULL) {
+        const uint64_t REPLAY_TICKS = 1 << 20;
+        recordAutopilotSession(REPLAY_TICKS, seed);
+        ReplayResult replay;
+        benchCase("replay", size, (double)REPLAY_TICKS, [&]() { replay = replayRecording(inputRecording); });
+        fprintf(stderr, "  %-18s %6d  %llu events in %zu bytes, goal on tick %llu, 1M ticks in %.1f ms\n", "", size,
+                (unsigned long long)inputRecording.eventCount, inputRecording.events.size(),
+                (unsigned long long)inputRecording.finishTick, replay.elapsedMs);
+        if (!replay.stateMatches || !replay.finishMatches || inputRecording.finishTick == 0) {
+            fprintf(stderr, "  REPLAY MISMATCH on the %dx%d maze\n", size, size);
+            consistent = false;
+        }
+    }
+
+    // One tick of 100,000 agents, a quarter of them chasing a point that
+    // changes cell every 64 ticks (so the shared field is rebuilt as in game)
+    if (benchFilter.empty() || strstr("agents_update", benchFilter.c_str()) != NULL) {
+        const size_t AGENT_COUNT = 100000;
+        spawnAgents(agents, AGENT_COUNT, 0.25f, seed);
+        uint64_t agentTick = 0;
+        benchCase("agents_update", size, 1.0, [&]() {
+            int cell = (int)((agentTick++ / 64) % size) + 1;
+            updateAgents(agents, (float)tickSeconds, (float)cell, (float)cell);
+        });
+        for (size_t i = 0; i < agents.count; i++) {
+            if (maze.isWall((int)(agents.x[i] + 0.5f), (int)(agents.z[i] + 0.5f))) {
+                fprintf(stderr, "  AGENT IN A WALL on the %dx%d maze\n", size, size);
+                consistent = false;
+                break;
+            }
+        }
+    }
+
+    // Give the big buffers back before the next size
+    solver = MazeSolver();
+    inputRecording = InputRecording();
+    agents = AgentSet();
+    return consistent;
+}
+
+static void writeResults(FILE* out, bool csv, unsigned int seed)
+{
+    if (csv) {
+        fprintf(out, "case,size,iterations,runs,median_ns_per_op,min_ns_per_op\n");
+        for (const BenchResult& result : results) {
+            fprintf(out, "%s,%d,%lld,%d,%.3f,%.3f\n", result.name.c_str(), result.size, result.iterations, result.runs,
+                    result.medianNs, result.minNs);
+        }
+        return;
+    }
+
+#if defined(__AVX2__)
+    const char* kernel = "AVX2";
+#else
+    const char* kernel = "scalar";
+#endif
+    fprintf(out, "{\n  \"benchmark\": \"maze_core\",\n  \"seed\": %u,\n  \"flood_kernel\": \"%s\",\n  \"threads\": %u,\n  \"results\": [\n",
+            seed, kernel, workerPool().threadCount());
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        fprintf(out, "    {\"case\": \"%s\", \"size\": %d, \"iterations\": %lld, \"runs\": %d, \"median_ns_per_op\": %.3f, \"min_ns_per_op\": %.3f}%s\n",
+                result.name.c_str(), result.size, result.iterations, result.runs, result.medianNs, result.minNs,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+// Read an earlier run in either output format. Only the case, size and median
+// are used; JSON files are expected in the one-result-per-line layout written above.
+static bool readBaseline(const std::string& path, std::vector<BenchResult>& baseline)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        fprintf(stderr, "Could not open baseline %s\n", path.c_str());
+        return false;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        BenchResult result;
+        char name[64];
+        const char* caseField = strstr(line, "\"case\": \"");
+        if (caseField) {
+            const char* sizeField = strstr(line, "\"size\": ");
+            const char* medianField = strstr(line, "\"median_ns_per_op\": ");
+            if (!sizeField || !medianField || sscanf(caseField + 9, "%63[^\"]", name) != 1) {
+                continue;
+            }
+            result.size = atoi(sizeField + 8);
+            result.medianNs = atof(medianField + 20);
+        }
+        else if (sscanf(line, "%63[^,],%d,%lld,%d,%lf", name, &result.size, &result.iterations, &result.runs, &result.medianNs) != 5) {
+            continue;   // the CSV header, or anything else
+        }
+        result.name = name;
+        baseline.push_back(result);
+    }
+    fclose(file);
+    return true;
+}
+
+// Compare against the baseline; returns the number of regressions
+static int compareResults(const std::vector<BenchResult>& baseline, double thresholdPercent)
+{
+    int regressions = 0;
+    int compared = 0;
+    fprintf(stderr, "\nAgainst the baseline (regression above +%.1f%%):\n", thresholdPercent);
+    for (const BenchResult& result : results) {
+        auto match = std::find_if(baseline.begin(), baseline.end(), [&](const BenchResult& old) {
+            return old.name == result.name && old.size == result.size;
+        });
+        if (match == baseline.end() || match->medianNs <= 0.0) {
+            continue;
+        }
+        compared++;
+        double change = (result.medianNs / match->medianNs - 1.0) * 100.0;
+        bool regressed = change > thresholdPercent;
+        regressions += regressed;
+        fprintf(stderr, "  %-18s %6d  %14.1f -> %14.1f ns/op  %+7.1f%%%s\n", result.name.c_str(), result.size,
+                match->medianNs, result.medianNs, change, regressed ? "  REGRESSION" : "");
+    }
+    fprintf(stderr, "%d case(s) compared, %d regression(s)\n", compared, regressions);
+    return regressions;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<int> sizes = { 10, 15, 20, 64, 256, 1024, 4096, 8192 };
+    unsigned int seed = 12345;
+    bool csv = false;
+    std::string outputPath;
+    std::string baselinePath;
+    double thresholdPercent = 10.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            for (char* token = strtok(argv[++i], ","); token; token = strtok(NULL, ",")) {
+                sizes.push_back(std::max(2, atoi(token)));
+            }
+        }
+        else if (arg == "--repeats" && i + 1 < argc) {
+            benchRepeats = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--filter" && i + 1 < argc) {
+            benchFilter = argv[++i];
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        }
+        else if (arg == "--format" && i + 1 < argc) {
+            csv = std::string(argv[++i]) == "csv";
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        }
+        else if (arg == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        }
+        else if (arg == "--threshold" && i + 1 < argc) {
+            thresholdPercent = atof(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    // Read the baseline first, it may be the file the results are about to replace
+    std::vector<BenchResult> baseline;
+    if (!baselinePath.empty() && !readBaseline(baselinePath, baseline)) {
+        return 1;
+    }
+
+    fprintf(stderr, "Maze core benchmark, seed %u, %u worker thread(s)\n", seed, workerPool().threadCount());
+    bool consistent = checkCollisionCases();
+    for (int size : sizes) {
+        consistent = benchSize(size, seed) && consistent;
+    }
+
+    FILE* out = stdout;
+    if (!outputPath.empty()) {
+        out = fopen(outputPath.c_str(), "w");
+        if (!out) {
+            fprintf(stderr, "Could not write %s\n", outputPath.c_str());
+            return 1;
+        }
+    }
+    writeResults(out, csv, seed);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    int regressions = baselinePath.empty() ? 0 : compareResults(baseline, thresholdPercent);
+    if (!consistent) {
+        return 2;
+    }
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,2531 @@
+#include "maze_core.h"
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+int MAZE_SIZE = 0;
+
+MazeGrid maze;
+unsigned int mazeSeed = 0;
+int mazeGenerator = -1;
+
+bool endlessMode = false;
+int64_t endlessWindowChunk = 0;
+std::vector<EndlessChunk> endlessCache;
+uint64_t endlessClock = 0;
+uint64_t endlessChunksGenerated = 0;
+int64_t endlessFurthestRow = 0;
+
+void* mazeFileMapping = nullptr;
+size_t mazeFileMappingBytes = 0;
+
+// Player settings
+float playerX = 1.0f;
+float playerY = 0.5f;
+float playerZ = 1.0f;
+float playerAngle = 0.0f;
+float playerLookUpDown = 0.0f;
+
+// 0.05 units and 3 degrees per 16 ms tick before the fixed timestep
+float cameraSpeed = 3.125f;
+float rotationSpeed = 187.5f;
+
+bool controlStates[CONTROL_COUNT] = { false };
+
+bool gameFinished = false;
+bool showCongratsMessage = false;
+double finalTimeMs = 0.0;
+uint64_t finishTick = 0;
+
+int tickRate = 120;                     // "--tick-rate N"
+double tickSeconds = 1.0 / 120;
+uint64_t simTick = 0;
+uint64_t missedTicks = 0;
+float prevPlayerX = 1.0f;
+float prevPlayerZ = 1.0f;
+float prevPlayerAngle = 0.0f;
+
+TripleBuffer<GameSnapshot> gameSnapshots;
+InputQueue inputQueue;
+std::thread simulationThread;
+std::atomic<bool> simulationRunning{ false };
+std::atomic<bool> simulationPauseRequested{ false };
+std::atomic<bool> simulationPaused{ false };
+
+MazeSolver solver;
+
+const char* const profileStageNames[PROFILE_STAGE_COUNT] = {
+    "display", "updateFrameState", "drawMaze", "drawHintPath", "drawMinimap", "drawTimer", "drawInstructions",
+    "drawStats", "drawProfiler", "drawCongratsMessage", "drawHudText", "swapBuffers", "simulationTick",
+    "processMovement", "checkCollision", "updateAgents", "drawAgents"
+};
+ProfileRing profileRings[PROFILE_THREAD_COUNT];
+std::atomic<bool> profilerEnabled{ false };
+thread_local int profileThread = PROFILE_THREAD_RENDER;
+
+AgentSet agents;
+TripleBuffer<AgentSnapshot> agentSnapshots;
+
+InputRecording inputRecording;
+bool recordingInput = false;
+
+int mazeSizeForDifficulty(int difficulty)
+{
+    if (difficulty == DIFFICULTY_EASY) {
+        return 10;
+    }
+    else if (difficulty == DIFFICULTY_MEDIUM) {
+        return 15;
+    }
+    else {
+        return 20;
+    }
+}
+
+thread_local bool backgroundThread = false;
+thread_local bool simulationPoolThread = false;
+
+ThreadPool& workerPool()
+{
+    if (backgroundThread) {
+        static ThreadPool backgroundPool(std::max(1u, std::thread::hardware_concurrency()));
+        return backgroundPool;
+    }
+    if (simulationPoolThread) {
+        static ThreadPool simulationPool(std::max(1u, std::thread::hardware_concurrency()));
+        return simulationPool;
+    }
+    static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount)
+{
+    threadCount = std::max(1u, threadCount);
+    for (unsigned t = 0; t < threadCount; t++) {
+        queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+    }
+    for (unsigned t = 1; t < threadCount; t++) {
+        workers.emplace_back([this, t] { workerLoop(t); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::run(int jobCount, const std::function<void(int)>& job)
+{
+    if (jobCount <= 0) {
+        return;
+    }
+
+    // Only one batch runs on the pool at a time
+    std::lock_guard<std::mutex> callLock(callMutex);
+
+    unsigned queueCount = threadCount();
+    for (unsigned q = 0; q < queueCount; q++) {
+        std::lock_guard<std::mutex> queueLock(queues[q]->mutex);
+        for (int index = (int)q; index < jobCount; index += (int)queueCount) {
+            queues[q]->jobs.push_back(index);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    currentJob = &job;
+    busyWorkers = (int)workers.size();
+    generation++;
+    lock.unlock();
+    wake.notify_all();
+
+    work(0);
+
+    lock.lock();
+    done.wait(lock, [this] { return busyWorkers == 0; });
+    currentJob = nullptr;
+}
+
+void WorkStealingPool::workerLoop(unsigned self)
+{
+    unsigned seenGeneration = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+        if (stopping) {
+            return;
+        }
+        seenGeneration = generation;
+
+        lock.unlock();
+        work(self);
+        lock.lock();
+
+        if (--busyWorkers == 0) {
+            done.notify_all();
+        }
+    }
+}
+
+// Run jobs until there are none left to take anywhere. Jobs are only added
+// before the workers start, so once every deque is empty the rest are running.
+void WorkStealingPool::work(unsigned self)
+{
+    int index;
+    while (takeJob(self, index)) {
+        (*currentJob)(index);
+    }
+}
+
+// Newest job of our own deque, or failing that the oldest of someone else's
+bool WorkStealingPool::takeJob(unsigned self, int& index)
+{
+    {
+        JobQueue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            index = own.jobs.back();
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+    unsigned queueCount = threadCount();
+    for (unsigned offset = 1; offset < queueCount; offset++) {
+        JobQueue& victim = *queues[(self + offset) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            index = victim.jobs.front();
+            victim.jobs.pop_front();
+            steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+JobGraph::JobGraph(unsigned threadCount)
+    : threadCount(std::max(1u, threadCount))
+{
+}
+
+JobGraph::~JobGraph()
+{
+    wait();
+}
+
+int JobGraph::add(std::function<void()> job, std::initializer_list<int> after)
+{
+    int id = (int)jobs.size();
+    jobs.emplace_back();
+    jobs[id].run = std::move(job);
+    for (int dependency : after) {
+        jobs[dependency].next.push_back(id);
+        jobs[id].waitingFor++;
+    }
+    return id;
+}
+
+void JobGraph::start()
+{
+    for (int id = 0; id < jobCount(); id++) {
+        if (jobs[id].waitingFor == 0) {
+            ready.push_back(id);
+        }
+    }
+    unsigned count = std::min(threadCount, (unsigned)std::max(1, jobCount()));
+    for (unsigned t = 0; t < count; t++) {
+        threads.emplace_back([this] { workerLoop(); });
+    }
+}
+
+void JobGraph::wait()
+{
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+}
+
+// Take ready jobs until every job has run. Finishing a job may make the jobs
+// waiting on it ready.
+void JobGraph::workerLoop()
+{
+    backgroundThread = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return !ready.empty() || finished(); });
+        if (ready.empty()) {
+            return;
+        }
+        int id = ready.front();
+        ready.pop_front();
+
+        lock.unlock();
+        jobs[id].run();
+        lock.lock();
+
+        for (int next : jobs[id].next) {
+            if (--jobs[next].waitingFor == 0) {
+                ready.push_back(next);
+            }
+        }
+        completed.fetch_add(1, std::memory_order_release);
+        wake.notify_all();
+    }
+}
+
+// Apply one input event before the next tick, recording it if asked to
+void applyInputEvent(InputEvent event)
+{
+    if (event.type == INPUT_CONTROL_DOWN) {
+        controlStates[event.control] = true;
+    }
+    else if (event.type == INPUT_CONTROL_UP) {
+        controlStates[event.control] = false;
+    }
+    else if (event.type == INPUT_DISMISS_CONGRATS) {
+        showCongratsMessage = false;
+    }
+
+    if (recordingInput) {
+        uint64_t delta = simTick - inputRecording.lastEventTick;
+        do {
+            inputRecording.events.push_back((uint8_t)(delta & 0x7f) | (delta >= 0x80 ? 0x80 : 0));
+            delta >>= 7;
+        } while (delta != 0);
+        inputRecording.events.push_back((uint8_t)(event.type << 4 | event.control));
+        inputRecording.eventCount++;
+        inputRecording.lastEventTick = simTick;
+    }
+}
+
+// One fixed simulation step of tickSeconds with the current controls
+void simulationStep()
+{
+    prevPlayerX = playerX;
+    prevPlayerZ = playerZ;
+    prevPlayerAngle = playerAngle;
+    simTick++;
+
+    // Process player movement if game not finished
+    if (!showCongratsMessage) {
+        processMovement((float)tickSeconds);
+    }
+
+    // Agents keep going whatever the player does
+    updateAgents(agents, (float)tickSeconds, playerX, playerZ);
+
+    // Check for game completion (the endless maze has no goal). The run time is
+    // the simulated time, so it is exact to the tick whatever the frame rate.
+    if (!endlessMode && !gameFinished && playerX > MAZE_SIZE - 1.5f && playerZ > MAZE_SIZE - 1.5f) {
+        gameFinished = true;
+        showCongratsMessage = true;
+        finishTick = simTick;
+        finalTimeMs = simTick * tickSeconds * 1000.0;
+    }
+}
+
+// One tick on the simulation thread: the input that arrived since the last
+// tick, then the step
+void simulationTick()
+{
+    PROFILE_SCOPE(PROFILE_SIMULATION_TICK);
+    InputEvent event;
+    while (inputQueue.pop(event)) {
+        applyInputEvent(event);
+    }
+    simulationStep();
+}
+
+void publishSnapshot(std::chrono::steady_clock::time_point tickTime)
+{
+    GameSnapshot& snapshot = gameSnapshots.writeSlot();
+    snapshot.tick = simTick;
+    snapshot.tickTime = tickTime;
+    snapshot.windowChunk = endlessWindowChunk;
+    snapshot.playerX = playerX;
+    snapshot.playerZ = playerZ;
+    snapshot.playerAngle = playerAngle;
+    snapshot.prevPlayerX = prevPlayerX;
+    snapshot.prevPlayerZ = prevPlayerZ;
+    snapshot.prevPlayerAngle = prevPlayerAngle;
+    snapshot.missedTicks = missedTicks;
+    snapshot.gameFinished = gameFinished;
+    snapshot.showCongratsMessage = showCongratsMessage;
+    snapshot.finalTimeMs = finalTimeMs;
+    gameSnapshots.publish();
+    if (agents.count > 0) {
+        publishAgentSnapshot(agents, simTick);
+    }
+}
+
+// Simulation thread: sleep until the next tick is due, run every tick that is
+// due, publish the result
+void simulationLoop()
+{
+    profileThread = PROFILE_THREAD_SIMULATION;
+    simulationPoolThread = true;
+    auto tickDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(tickSeconds));
+    auto nextTick = std::chrono::steady_clock::now() + tickDuration;
+
+    while (simulationRunning.load(std::memory_order_acquire)) {
+        if (simulationPauseRequested.load(std::memory_order_acquire)) {
+            simulationPaused.store(true, std::memory_order_release);
+            while (simulationPauseRequested.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            simulationPaused.store(false, std::memory_order_release);
+        }
+
+        std::this_thread::sleep_until(nextTick);
+        auto now = std::chrono::steady_clock::now();
+        int ticks = (int)((now - nextTick) / tickDuration) + 1;
+        if (ticks > MAX_CATCH_UP_TICKS) {
+            // Too far behind (a stall or a breakpoint) - drop the rest instead of spiralling
+            missedTicks += ticks - MAX_CATCH_UP_TICKS;
+            nextTick += (ticks - MAX_CATCH_UP_TICKS) * tickDuration;
+            ticks = MAX_CATCH_UP_TICKS;
+        }
+        for (int t = 0; t < ticks; t++) {
+            simulationTick();
+            nextTick += tickDuration;
+        }
+        publishSnapshot(nextTick - tickDuration);
+    }
+}
+
+void startSimulation()
+{
+    prevPlayerX = playerX;
+    prevPlayerZ = playerZ;
+    prevPlayerAngle = playerAngle;
+    GameSnapshot initial;
+    initial.tickTime = std::chrono::steady_clock::now();
+    gameSnapshots.reset(initial);
+    publishSnapshot(initial.tickTime);
+
+    simulationRunning.store(true);
+    simulationThread = std::thread(simulationLoop);
+}
+
+void stopSimulation()
+{
+    if (simulationThread.joinable()) {
+        simulationRunning.store(false, std::memory_order_release);
+        simulationThread.join();
+    }
+}
+
+// Hold the simulation thread between ticks so the render thread can change
+// state it reads (the endless window slide). Returns once it is parked - at
+// most one tick - and is the only point where the two threads wait on each other.
+void pauseSimulation()
+{
+    if (!simulationThread.joinable()) {
+        return;
+    }
+    simulationPauseRequested.store(true, std::memory_order_release);
+    while (!simulationPaused.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void resumeSimulation()
+{
+    if (!simulationThread.joinable()) {
+        return;
+    }
+    simulationPauseRequested.store(false, std::memory_order_release);
+    while (simulationPaused.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+// Back to the start of the current maze with the clock at zero, for the next
+// level. Held controls stay held. Only while the simulation thread is stopped.
+void resetRun()
+{
+    playerX = prevPlayerX = 1.0f;
+    playerZ = prevPlayerZ = 1.0f;
+    playerAngle = prevPlayerAngle = 0.0f;
+    gameFinished = false;
+    showCongratsMessage = false;
+    finalTimeMs = 0.0;
+    finishTick = 0;
+    simTick = 0;
+}
+
+// A fresh run on its own size x size maze (always the DFS generator - session
+// mazes are small, and the tiled one would queue up on the shared worker pool)
+void startSession(GameSession& session, uint32_t id, int size, unsigned int seed)
+{
+    session = GameSession();
+    session.id = id;
+    session.mazeSize = size;
+    session.seed = seed;
+    generateMazeGrid(session.grid, size, seed, GENERATOR_DFS);
+}
+
+// One tick of a session, the same rules as simulationStep() for the game
+void stepSession(GameSession& session, float dt)
+{
+    session.tick++;
+    if (session.finishTick != 0) {
+        return;
+    }
+    movePlayer(session.grid, session.controls, dt, session.playerX, session.playerZ, session.playerAngle);
+    float goal = session.mazeSize - 1.5f;
+    if (session.playerX > goal && session.playerZ > goal) {
+        session.finishTick = session.tick;
+    }
+}
+
+// Start recording the input of a session on the current maze, from the
+// current player state. Call before the simulation starts.
+void startRecording(int difficulty)
+{
+    inputRecording = InputRecording();
+    inputRecording.mazeSize = MAZE_SIZE;
+    inputRecording.seed = mazeSeed;
+    inputRecording.generator = mazeGenerator;
+    inputRecording.difficulty = difficulty;
+    inputRecording.tickRate = tickRate;
+    inputRecording.mazeChecksum = maze.checksum();
+    inputRecording.startX = playerX;
+    inputRecording.startZ = playerZ;
+    inputRecording.startAngle = playerAngle;
+    inputRecording.lastEventTick = simTick;
+    recordingInput = true;
+}
+
+// Close the recording with the state the session ended in (simulation stopped)
+void finishRecording()
+{
+    recordingInput = false;
+    inputRecording.tickCount = simTick;
+    inputRecording.finishTick = finishTick;
+    inputRecording.finalX = playerX;
+    inputRecording.finalZ = playerZ;
+    inputRecording.finalAngle = playerAngle;
+}
+
+// Recording files: a fixed 96-byte little-endian header, then the event bytes
+struct RecordingFileHeader {
+    char magic[4];            // "MREC"
+    uint32_t version;
+    uint32_t headerBytes;     // event bytes offset
+    int32_t mazeSize;
+    uint32_t seed;
+    uint32_t generator;
+    int32_t difficulty;
+    uint32_t tickRate;
+    uint64_t mazeChecksum;
+    uint64_t eventCount;
+    uint64_t eventBytes;
+    uint64_t tickCount;
+    uint64_t finishTick;
+    float startX, startZ, startAngle;
+    float finalX, finalZ, finalAngle;
+};
+
+bool saveRecording(const InputRecording& recording, const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "Could not write recording " << path << std::endl;
+        return false;
+    }
+
+    RecordingFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "MREC", 4);
+    header.version = RECORDING_FILE_VERSION;
+    header.headerBytes = sizeof(RecordingFileHeader);
+    header.mazeSize = recording.mazeSize;
+    header.seed = recording.seed;
+    header.generator = (uint32_t)recording.generator;
+    header.difficulty = recording.difficulty;
+    header.tickRate = (uint32_t)recording.tickRate;
+    header.mazeChecksum = recording.mazeChecksum;
+    header.eventCount = recording.eventCount;
+    header.eventBytes = recording.events.size();
+    header.tickCount = recording.tickCount;
+    header.finishTick = recording.finishTick;
+    header.startX = recording.startX;
+    header.startZ = recording.startZ;
+    header.startAngle = recording.startAngle;
+    header.finalX = recording.finalX;
+    header.finalZ = recording.finalZ;
+    header.finalAngle = recording.finalAngle;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(recording.events.data(), 1, recording.events.size(), file) == recording.events.size();
+    ok = fclose(file) == 0 && ok;
+
+    std::cout << (ok ? "Input recorded to " : "Failed to save the recording to ") << path << " (" << recording.tickCount
+              << " ticks, " << recording.eventCount << " events in " << recording.events.size() << " bytes)" << std::endl;
+    return ok;
+}
+
+bool loadRecording(const std::string& path, InputRecording& recording)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        std::cout << "Could not open recording " << path << std::endl;
+        return false;
+    }
+
+    RecordingFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, "MREC", 4) == 0
+        && header.version == RECORDING_FILE_VERSION
+        && header.headerBytes == sizeof(RecordingFileHeader)
+        && header.mazeSize >= 2
+        && header.tickRate > 0;
+
+    if (ok) {
+        recording = InputRecording();
+        recording.mazeSize = header.mazeSize;
+        recording.seed = header.seed;
+        recording.generator = (int)header.generator;
+        recording.difficulty = header.difficulty;
+        recording.tickRate = (int)header.tickRate;
+        recording.mazeChecksum = header.mazeChecksum;
+        recording.eventCount = header.eventCount;
+        recording.tickCount = header.tickCount;
+        recording.finishTick = header.finishTick;
+        recording.startX = header.startX;
+        recording.startZ = header.startZ;
+        recording.startAngle = header.startAngle;
+        recording.finalX = header.finalX;
+        recording.finalZ = header.finalZ;
+        recording.finalAngle = header.finalAngle;
+        recording.events.resize(header.eventBytes);
+        ok = fread(recording.events.data(), 1, recording.events.size(), file) == recording.events.size();
+    }
+    fclose(file);
+
+    if (!ok) {
+        std::cout << "Unsupported or damaged recording " << path << std::endl;
+    }
+    return ok;
+}
+
+// Run a recorded session again on the current maze (the caller regenerates it
+// from the recording) without any pacing, and compare how it ends
+ReplayResult replayRecording(const InputRecording& recording)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    tickRate = recording.tickRate;
+    tickSeconds = 1.0 / tickRate;
+    playerX = prevPlayerX = recording.startX;
+    playerZ = prevPlayerZ = recording.startZ;
+    playerAngle = prevPlayerAngle = recording.startAngle;
+    std::fill(controlStates, controlStates + CONTROL_COUNT, false);
+    gameFinished = false;
+    showCongratsMessage = false;
+    finalTimeMs = 0.0;
+    finishTick = 0;
+    simTick = 0;
+
+    const uint8_t* next = recording.events.data();
+    const uint8_t* end = next + recording.events.size();
+    uint64_t eventTick = 0;
+    bool haveEvent = false;
+    auto readEvent = [&]() {
+        uint64_t delta = 0;
+        int shift = 0;
+        while (next < end && (*next & 0x80)) {
+            delta |= (uint64_t)(*next++ & 0x7f) << shift;
+            shift += 7;
+        }
+        haveEvent = next + 1 < end;
+        if (haveEvent) {
+            delta |= (uint64_t)*next++ << shift;
+            eventTick += delta;
+        }
+    };
+    readEvent();
+
+    while (simTick < recording.tickCount) {
+        while (haveEvent && eventTick == simTick) {
+            InputEvent event = { (uint8_t)(*next >> 4), (uint8_t)(*next & 15) };
+            next++;
+            applyInputEvent(event);
+            readEvent();
+        }
+        simulationStep();
+    }
+
+    ReplayResult result;
+    result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    result.ticks = simTick;
+    result.finalX = playerX;
+    result.finalZ = playerZ;
+    result.finalAngle = playerAngle;
+    result.finishTick = finishTick;
+    float turn = fabsf(playerAngle - recording.finalAngle);
+    result.stateMatches = fabsf(playerX - recording.finalX) <= REPLAY_POSITION_TOLERANCE
+        && fabsf(playerZ - recording.finalZ) <= REPLAY_POSITION_TOLERANCE
+        && std::min(turn, 360.0f - turn) <= REPLAY_POSITION_TOLERANCE * 360.0f;
+    result.finishMatches = finishTick == recording.finishTick;
+    return result;
+}
+
+// Chrome trace JSON (chrome://tracing, Perfetto) - one complete ("X") event per
+// scope, timestamps in microseconds from the first event
+bool writeChromeTrace(const std::vector<ProfileEvent>& events, uint64_t droppedEvents, const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        std::cout << "Could not write " << path << std::endl;
+        return false;
+    }
+
+    uint64_t originNs = events.empty() ? 0 : events[0].startNs;
+    for (const ProfileEvent& event : events) {
+        originNs = std::min(originNs, event.startNs);
+    }
+
+    const char* threadNames[PROFILE_THREAD_COUNT] = { "render", "simulation" };
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":%llu},\"traceEvents\":[\n",
+            (unsigned long long)droppedEvents);
+    for (int t = 0; t < PROFILE_THREAD_COUNT; t++) {
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+                t, threadNames[t]);
+    }
+    for (size_t i = 0; i < events.size(); i++) {
+        const ProfileEvent& event = events[i];
+        fprintf(file, "{\"name\":\"%s\",\"cat\":\"maze\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+                profileStageNames[event.stage], event.thread, (event.startNs - originNs) / 1000.0, event.durationNs / 1000.0,
+                i + 1 < events.size() ? "," : "");
+    }
+    fprintf(file, "]}\n");
+    if (fclose(file) != 0) {
+        std::cout << "Could not write " << path << std::endl;
+        return false;
+    }
+    std::cout << "Trace of " << events.size() << " events written to " << path << std::endl;
+    return true;
+}
+
+// Wall bit of cell (x, z), cells outside the grid counting as wall. Branch-free:
+// the coordinates are clamped for the read and the outside test is or-ed in.
+static inline uint32_t wallAt(const MazeGrid& grid, int x, int z)
+{
+    int clampedX = std::min(std::max(x, 0), grid.width() - 1);
+    int clampedZ = std::min(std::max(z, 0), grid.height() - 1);
+    uint32_t outside = (uint32_t)(x != clampedX) | (uint32_t)(z != clampedZ);
+    return (uint32_t)(grid.row(clampedZ)[clampedX >> 6] >> (clampedX & 63) & 1) | outside;
+}
+
+// The eight cells around a circle's cell: the four sides, then the corners
+static const int collisionNeighbourX[8] = { -1, 1, 0, 0, -1, 1, -1, 1 };
+static const int collisionNeighbourZ[8] = { 0, 0, -1, 1, -1, -1, 1, 1 };
+
+// Push a circle at (x, z) out of the wall cells around it. A circle of radius
+// below half a cell can only reach the eight cells around the one its centre is
+// in, and the centre itself never gets into a wall (see sweepCircles()). A side
+// wall just clamps one coordinate; a corner pushes the circle straight away
+// from the wall's corner. Every cell is handled the same way whether it is a
+// wall or not, an open cell just moving the circle by zero. The sides go first,
+// so a circle pressed against a flat wall is already clear of the corner cells
+// behind it.
+static inline void pushOutOfWalls(const MazeGrid& grid, float radius, float& x, float& z)
+{
+    int cellX = (int)(x + 0.5f);
+    int cellZ = (int)(z + 0.5f);
+    float wallMinusX = (float)wallAt(grid, cellX - 1, cellZ);
+    float wallPlusX = (float)wallAt(grid, cellX + 1, cellZ);
+    float wallMinusZ = (float)wallAt(grid, cellX, cellZ - 1);
+    float wallPlusZ = (float)wallAt(grid, cellX, cellZ + 1);
+    x += (std::max(x, cellX - 0.5f + radius) - x) * wallMinusX;
+    x += (std::min(x, cellX + 0.5f - radius) - x) * wallPlusX;
+    z += (std::max(z, cellZ - 0.5f + radius) - z) * wallMinusZ;
+    z += (std::min(z, cellZ + 0.5f - radius) - z) * wallPlusZ;
+
+    for (int n = 4; n < 8; n++) {
+        float cornerX = cellX + 0.5f * collisionNeighbourX[n];
+        float cornerZ = cellZ + 0.5f * collisionNeighbourZ[n];
+        float awayX = x - cornerX;
+        float awayZ = z - cornerZ;
+        float distance = sqrtf(awayX * awayX + awayZ * awayZ);
+        float depth = std::max(radius - distance, 0.0f)
+                      * (float)wallAt(grid, cellX + collisionNeighbourX[n], cellZ + collisionNeighbourZ[n]);
+        float scale = depth / std::max(distance, 1e-6f);
+        x += awayX * scale;
+        z += awayZ * scale;
+    }
+}
+
+// Whether a circle at (x, z) overlaps a wall (or its centre is in one)
+bool circleHitsWall(const MazeGrid& grid, float x, float z, float radius)
+{
+    int cellX = (int)(x + 0.5f);
+    int cellZ = (int)(z + 0.5f);
+    uint32_t hit = wallAt(grid, cellX, cellZ);
+    for (int n = 0; n < 8; n++) {
+        int wallX = cellX + collisionNeighbourX[n];
+        int wallZ = cellZ + collisionNeighbourZ[n];
+        float awayX = x - std::min(std::max(x, wallX - 0.5f), wallX + 0.5f);
+        float awayZ = z - std::min(std::max(z, wallZ - 0.5f), wallZ + 0.5f);
+        hit |= wallAt(grid, wallX, wallZ) & (uint32_t)(awayX * awayX + awayZ * awayZ < radius * radius);
+    }
+    return hit != 0;
+}
+
+// Collision of the player at (x, z) with the walls of grid
+bool checkCollision(const MazeGrid& grid, float x, float z)
+{
+    PROFILE_SCOPE(PROFILE_CHECK_COLLISION);
+    return circleHitsWall(grid, x, z, PLAYER_RADIUS);
+}
+
+bool checkCollision(float x, float y, float z)
+{
+    return checkCollision(maze, x, z);
+}
+
+// Move count circles of radius (below half a cell) at (x[i], z[i]) by
+// (moveX[i], moveZ[i]), sliding along the walls. The whole batch takes as many
+// steps as its longest move needs, so every step is the same straight-line
+// loop over all the circles. Steps are shorter than the radius: from a circle
+// clear of the walls that cannot get the centre into a wall, so the push out
+// always goes back the way the circle came in.
+void sweepCircles(const MazeGrid& grid, float radius, size_t count, float* x, float* z, const float* moveX,
+                  const float* moveZ)
+{
+    PROFILE_SCOPE(PROFILE_CHECK_COLLISION);
+
+    float longest = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        longest = std::max(longest, fabsf(moveX[i]) + fabsf(moveZ[i]));
+    }
+    int steps = std::max(1, (int)ceilf(longest / (COLLISION_STEP_RADII * radius)));
+    float fraction = 1.0f / steps;
+
+    for (int step = 0; step < steps; step++) {
+        for (size_t i = 0; i < count; i++) {
+            float newX = x[i] + moveX[i] * fraction;
+            float newZ = z[i] + moveZ[i] * fraction;
+            pushOutOfWalls(grid, radius, newX, newZ);
+            x[i] = newX;
+            z[i] = newZ;
+        }
+    }
+}
+
+void moveCircle(const MazeGrid& grid, float radius, float& x, float& z, float moveX, float moveZ)
+{
+    sweepCircles(grid, radius, 1, &x, &z, &moveX, &moveZ);
+}
+
+// One movement step of dt seconds for a player at (x, z) facing angle in grid,
+// with the given CONTROL_* states held down
+void movePlayer(const MazeGrid& grid, const bool* controls, float dt, float& x, float& z, float& angle)
+{
+    PROFILE_SCOPE(PROFILE_PROCESS_MOVEMENT);
+
+    // Calculate movement vectors based on player orientation
+    //shows in which direction the player is facing
+    float dx = sin(angle * M_PI / 180.0f);    //left, right
+    float dz = -cos(angle * M_PI / 180.0f);   //forward and backwork
+
+    float newX = x;
+    float newZ = z;
+
+    // Process movement controls (the arrow keys in the game)
+    if (controls[CONTROL_FORWARD]) {    //up key is there which moves forward
+        newX += dx * cameraSpeed * dt;
+        newZ += dz * cameraSpeed * dt;
+    }
+    if (controls[CONTROL_BACKWARD]) {       //down arrow moves backward
+        newX -= dx * cameraSpeed * dt;
+        newZ -= dz * cameraSpeed * dt;
+    }
+
+    // Left and Right arrow keys for rotation
+    if (controls[CONTROL_TURN_LEFT]) {      //changes the camera angle to left
+        angle -= rotationSpeed * dt;
+        if (angle < 0.0f) angle += 360.0f;
+    }
+    if (controls[CONTROL_TURN_RIGHT]) {    //camera angle to right
+        angle += rotationSpeed * dt;
+        if (angle >= 360.0f) angle -= 360.0f;
+    }
+
+    // Sweep the player to the new position, sliding along any wall in the way
+    moveCircle(grid, PLAYER_RADIUS, x, z, newX - x, newZ - z);
+}
+
+void processMovement(float dt)
+{
+    movePlayer(maze, controlStates, dt, playerX, playerZ, playerAngle);
+}
+
+// Randomized DFS over the cells (odd coordinates) of grid inside [minX, maxX] x [minY, maxY],
+// starting from (startX, startY). The stack holds packed (x, y) cell coordinates
+// to keep it small on huge mazes.
+static void carveMazeDFS(MazeGrid& grid, int startX, int startY, int minX, int maxX, int minY, int maxY, std::mt19937& rng)
+{
+    std::vector<uint64_t> stack;
+
+    // Define direction vectors
+    const int dx[] = { 0, 1, 0, -1 };
+    const int dy[] = { -1, 0, 1, 0 };
+
+    grid.setOpen(startX, startY);
+    stack.push_back(((uint64_t)startX << 32) | (uint32_t)startY);
+
+    while (!stack.empty()) {
+        int x = (int)(stack.back() >> 32);
+        int y = (int)(stack.back() & 0xffffffffu);
+
+        // Find unvisited neighbors
+        int neighbors[4];
+        int neighborCount = 0;
+        for (int i = 0; i < 4; i++) {
+            int nx = x + 2 * dx[i];
+            int ny = y + 2 * dy[i];
+
+            if (nx >= minX && nx <= maxX && ny >= minY && ny <= maxY && grid.isWall(nx, ny)) {
+                neighbors[neighborCount++] = i;
+            }
+        }
+
+        // If no unvisited neighbors, backtrack
+        if (neighborCount == 0) {
+            stack.pop_back();
+        }
+        else {
+            // Choose a random neighbor
+            int dir = neighbors[rng() % neighborCount];
+
+            // Carve a path
+            int nx = x + 2 * dx[dir];
+            int ny = y + 2 * dy[dir];
+            grid.setOpen(x + dx[dir], y + dy[dir]); // Remove wall between cells
+            grid.setOpen(nx, ny); // Mark new cell as visited
+
+            stack.push_back(((uint64_t)nx << 32) | (uint32_t)ny);
+        }
+    }
+}
+
+// Additional random openings on row j of grid (size cells wide, not counting the border) to
+// increase complexity (percent% chance of removing a wall). Neighbours only count when their
+// row lies within [minY, maxY].
+static void addExtraOpenings(MazeGrid& grid, int size, int j, int minY, int maxY, int percent, std::mt19937& rng)
+{
+    const int dx[] = { 0, 1, 0, -1 };
+    const int dy[] = { -1, 0, 1, 0 };
+
+    for (int i = 2; i < size; i++) {
+        if (grid.isWall(i, j) && (int)(rng() % 100) < percent) {
+            // Check if removing this wall would create a valid path
+            int pathCount = 0;
+            for (int k = 0; k < 4; k++) {
+                int nx = i + dx[k];
+                int ny = j + dy[k];
+                if (nx >= 1 && nx <= size && ny >= minY && ny <= maxY && !grid.isWall(nx, ny)) {
+                    pathCount++;
+                }
+            }
+
+            // Only remove if it connects at least 2 existing paths
+            if (pathCount >= 2) {
+                grid.setOpen(i, j);
+            }
+        }
+    }
+}
+
+// splitmix64 - turns (seed, index) into an independent, well-mixed 64-bit value
+static uint64_t mixSeed(uint64_t seed, uint64_t index)
+{
+    uint64_t z = seed + 0x9e3779b97f4a7c15ull * (index + 1);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// Original generator - one DFS over the whole grid, then the extra openings, all serial
+static void generateMazeDFS(MazeGrid& grid, int size, unsigned int seed, int extraOpeningPercent)
+{
+    std::mt19937 rng(seed);
+
+    // Start at (1,1) (accounting for boundary walls)
+    carveMazeDFS(grid, 1, 1, 1, size, 1, size, rng);
+
+    // Set entrance and exit
+    grid.setOpen(1, 1);
+    grid.setOpen(size, size);
+
+    // Walk row by row so consecutive tests stay in the same words
+    for (int j = 2; j < size; j++) {
+        addExtraOpenings(grid, size, j, 1, size, extraOpeningPercent, rng);
+    }
+}
+
+// Tiled generator for big mazes. The cells are split into square tiles that each
+// get their own DFS on the worker pool, then a Kruskal pass over the tile graph
+// opens exactly one passage per spanning-tree edge, so the result is still a
+// perfect maze. Every tile and row has its own RNG derived from the seed, so the
+// maze only depends on the seed, never on the number of threads.
+//
+// A tile is GENERATOR_TILE_CELLS cells = 128 grid columns wide and starts one
+// column after a multiple of 128, so tiles never share a 64-bit word of a row.
+static void generateMazeTiled(MazeGrid& grid, int size, unsigned int seed, int extraOpeningPercent)
+{
+    int cellsPerSide = (size + 1) / 2;     // cells sit on odd coordinates 1, 3, ... <= size
+    int tilesPerSide = (cellsPerSide + GENERATOR_TILE_CELLS - 1) / GENERATOR_TILE_CELLS;
+    int tileCount = tilesPerSide * tilesPerSide;
+
+    workerPool().parallelFor(0, tileCount, [&](int tile) {
+        int tileX = tile % tilesPerSide;
+        int tileY = tile / tilesPerSide;
+        int minX = 2 * tileX * GENERATOR_TILE_CELLS + 1;
+        int minY = 2 * tileY * GENERATOR_TILE_CELLS + 1;
+        int maxX = std::min(minX + 2 * (GENERATOR_TILE_CELLS - 1), size);
+        int maxY = std::min(minY + 2 * (GENERATOR_TILE_CELLS - 1), size);
+
+        std::mt19937 rng((uint32_t)mixSeed(seed, tile));
+        carveMazeDFS(grid, minX, minY, minX, maxX, minY, maxY, rng);
+    });
+
+    // Kruskal over the tiles: every edge between two neighbouring tiles gets a
+    // random weight, and the lightest edges that join two separate groups win
+    struct TileEdge {
+        uint64_t weight;
+        int tile;
+        bool horizontal;    // joins tile and the tile to its right, otherwise the one below
+    };
+    std::vector<TileEdge> edges;
+    for (int tile = 0; tile < tileCount; tile++) {
+        int tileX = tile % tilesPerSide;
+        int tileY = tile / tilesPerSide;
+        if (tileX + 1 < tilesPerSide) {
+            edges.push_back({ mixSeed(seed ^ 0x5eedu, 2 * (uint64_t)tile), tile, true });
+        }
+        if (tileY + 1 < tilesPerSide) {
+            edges.push_back({ mixSeed(seed ^ 0x5eedu, 2 * (uint64_t)tile + 1), tile, false });
+        }
+    }
+    std::sort(edges.begin(), edges.end(), [](const TileEdge& a, const TileEdge& b) { return a.weight < b.weight; });
+
+    std::vector<int> parent(tileCount);
+    for (int tile = 0; tile < tileCount; tile++) {
+        parent[tile] = tile;
+    }
+    auto findRoot = [&](int tile) {
+        while (parent[tile] != tile) {
+            parent[tile] = parent[parent[tile]];
+            tile = parent[tile];
+        }
+        return tile;
+    };
+
+    for (const TileEdge& edge : edges) {
+        int other = edge.horizontal ? edge.tile + 1 : edge.tile + tilesPerSide;
+        int rootA = findRoot(edge.tile);
+        int rootB = findRoot(other);
+        if (rootA == rootB) {
+            continue;
+        }
+        parent[rootA] = rootB;
+
+        // Open the wall between the two tiles next to a random cell along the shared side
+        int tileX = edge.tile % tilesPerSide;
+        int tileY = edge.tile / tilesPerSide;
+        int firstCell = (edge.horizontal ? tileY : tileX) * GENERATOR_TILE_CELLS;
+        int sideCells = std::min(GENERATOR_TILE_CELLS, cellsPerSide - firstCell);
+        int cell = firstCell + (int)(edge.weight % sideCells);
+        if (edge.horizontal) {
+            grid.setOpen(2 * (tileX + 1) * GENERATOR_TILE_CELLS, 2 * cell + 1);
+        }
+        else {
+            grid.setOpen(2 * cell + 1, 2 * (tileY + 1) * GENERATOR_TILE_CELLS);
+        }
+    }
+
+    // Set entrance and exit
+    grid.setOpen(1, 1);
+    grid.setOpen(size, size);
+
+    // Extra openings in bands of rows. Each row reads its neighbours, so even
+    // bands run first and odd bands after them; every row has its own RNG.
+    const int bandRows = 64;
+    int bandCount = (size - 2 + bandRows - 1) / bandRows;
+    for (int parity = 0; parity < 2; parity++) {
+        workerPool().parallelFor(0, (bandCount + 1 - parity) / 2, [&](int half) {
+            int band = 2 * half + parity;
+            int firstRow = 2 + band * bandRows;
+            int lastRow = std::min(firstRow + bandRows, size);
+            for (int j = firstRow; j < lastRow; j++) {
+                std::mt19937 rng((uint32_t)mixSeed(seed ^ 0x0be11u, j));
+                addExtraOpenings(grid, size, j, 1, size, extraOpeningPercent, rng);
+            }
+        });
+    }
+}
+
+// Generate a size x size maze from seed into grid (size + 2 square with the
+// border). generator is GENERATOR_DFS or GENERATOR_TILED.
+void generateMazeGrid(MazeGrid& grid, int size, unsigned int seed, int generator, int extraOpeningPercent)
+{
+    // Initialize maze with all walls
+    grid.resize(size + 2, size + 2, true);
+
+    if (generator == GENERATOR_TILED) {
+        generateMazeTiled(grid, size, seed, extraOpeningPercent);
+    }
+    else {
+        generateMazeDFS(grid, size, seed, extraOpeningPercent);
+    }
+
+    // The goal must be reachable from the start. With an even size the goal sits
+    // off the DFS lattice and only an extra opening may have connected it, so if
+    // none did, open the passage to the lattice cell diagonally before it.
+    std::vector<uint64_t> reached;
+    floodReachable(grid, 1, 1, reached);
+    if (!(reached[(size_t)size * grid.wordsPerRow() + (size >> 6)] >> (size & 63) & 1)) {
+        grid.setOpen(size - 1, size);
+    }
+}
+
+// Generate the game's maze. generator is GENERATOR_DFS, GENERATOR_TILED or -1
+// to pick by size.
+void generateMaze(int size, unsigned int seed, int generator)
+{
+    MAZE_SIZE = size;
+    mazeSeed = seed;
+    mazeGenerator = resolveGenerator(size, generator);
+    generateMazeGrid(maze, size, seed, mazeGenerator);
+}
+
+// The generator generateMaze() uses for generator (-1 picks by size)
+int resolveGenerator(int size, int generator)
+{
+    return generator >= 0 ? generator : size >= TILED_GENERATOR_MIN_SIZE ? GENERATOR_TILED : GENERATOR_DFS;
+}
+
+// Maze files ("--save FILE" / "--load FILE"). A fixed 64-byte little-endian
+// header is followed directly by the grid words in MazeGrid's own padded row
+// layout, so loading is an mmap plus a header check - no parsing, and pages are
+// only read in when the game touches them. Nothing run-dependent goes into the
+// file, so the same seed and size always give a byte-identical file.
+struct MazeFileHeader {
+    char magic[4];            // "MAZE"
+    uint32_t version;
+    uint32_t headerBytes;     // payload offset
+    int32_t mazeSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t wordsPerRow;
+    uint32_t seed;
+    uint32_t generator;       // GENERATOR_DFS / GENERATOR_TILED
+    uint32_t reserved[3];     // zero, pads the header to 64 bytes
+    uint64_t payloadBytes;
+    uint64_t checksum;        // MazeGrid::checksum() of the payload
+};
+static_assert(sizeof(MazeFileHeader) == 64, "maze file header must stay 64 bytes");
+
+bool saveMazeFile(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        std::cout << "Could not write maze file " << path << std::endl;
+        return false;
+    }
+
+    MazeFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "MAZE", 4);
+    header.version = MAZE_FILE_VERSION;
+    header.headerBytes = sizeof(MazeFileHeader);
+    header.mazeSize = MAZE_SIZE;
+    header.width = maze.width();
+    header.height = maze.height();
+    header.wordsPerRow = maze.wordsPerRow();
+    header.seed = mazeSeed;
+    header.generator = (uint32_t)mazeGenerator;
+    header.payloadBytes = maze.memoryBytes();
+    header.checksum = maze.checksum();
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(maze.data(), sizeof(uint64_t), maze.wordCount(), file) == maze.wordCount();
+    ok = fclose(file) == 0 && ok;
+
+    std::cout << (ok ? "Maze saved to " : "Failed to save maze to ") << path << std::endl;
+    return ok;
+}
+
+bool loadMazeFile(const std::string& path, bool verify)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "Could not open maze file " << path << std::endl;
+        return false;
+    }
+
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0 || (size_t)fileInfo.st_size < sizeof(MazeFileHeader)) {
+        std::cout << "Not a maze file: " << path << std::endl;
+        close(fd);
+        return false;
+    }
+
+    // Private writable mapping - the file is never modified, but the game may
+    // still carve into its copy of the pages
+    size_t fileBytes = (size_t)fileInfo.st_size;
+    void* mapping = mmap(NULL, fileBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cout << "Could not map maze file " << path << std::endl;
+        return false;
+    }
+
+    const MazeFileHeader* header = (const MazeFileHeader*)mapping;
+    bool ok = memcmp(header->magic, "MAZE", 4) == 0
+        && header->version == MAZE_FILE_VERSION
+        && header->headerBytes == sizeof(MazeFileHeader)
+        && header->mazeSize >= 2
+        && header->width == (uint32_t)header->mazeSize + 2
+        && header->height == header->width
+        && header->wordsPerRow == (header->width + 63) / 64
+        && header->payloadBytes == (uint64_t)header->wordsPerRow * header->height * sizeof(uint64_t)
+        && header->headerBytes + header->payloadBytes <= fileBytes;
+
+    if (!ok) {
+        std::cout << "Unsupported or damaged maze file " << path << std::endl;
+        munmap(mapping, fileBytes);
+        return false;
+    }
+
+    if (mazeFileMapping) {
+        munmap(mazeFileMapping, mazeFileMappingBytes);
+    }
+    mazeFileMapping = mapping;
+    mazeFileMappingBytes = fileBytes;
+
+    MAZE_SIZE = header->mazeSize;
+    mazeSeed = header->seed;
+    mazeGenerator = (int)header->generator;
+    maze.attach((uint64_t*)((char*)mapping + header->headerBytes), header->width, header->height);
+
+    // The checksum has to read every page, so it is only checked on request
+    if (verify && maze.checksum() != header->checksum) {
+        std::cout << "Checksum mismatch in maze file " << path << std::endl;
+        return false;
+    }
+
+    double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Maze " << MAZE_SIZE << "x" << MAZE_SIZE << " (seed " << mazeSeed << ") loaded from " << path
+              << " in " << elapsedMs << " ms" << (verify ? ", checksum OK" : "") << std::endl;
+    return true;
+}
+
+// Unmap the loaded maze file once `maze` has been replaced by another maze
+void closeMazeFile()
+{
+    if (mazeFileMapping) {
+        munmap(mazeFileMapping, mazeFileMappingBytes);
+        mazeFileMapping = nullptr;
+        mazeFileMappingBytes = 0;
+    }
+}
+
+// Fill one endless chunk. The cell rows are produced with Eller's algorithm,
+// which only keeps the set labels of the current row, so the work and memory
+// per row are O(width). The last row joins every set, which makes each chunk a
+// perfect maze on its own; row 0 is the seam to the previous chunk and gets a
+// single passage, so the chunks chain into one perfect maze. Everything is
+// derived from (seed, chunk index), so an evicted chunk comes back identical.
+static void generateEndlessChunk(int64_t chunkIndex, MazeGrid& grid)
+{
+    int width = MAZE_SIZE + 2;
+    int cells = (MAZE_SIZE + 1) / 2;      // cells sit on odd x = 1, 3, ... <= MAZE_SIZE
+    int cellRows = ENDLESS_CHUNK_ROWS / 2;
+    grid.resize(width, ENDLESS_CHUNK_ROWS, true);
+
+    std::mt19937 rng((uint32_t)mixSeed(mazeSeed, (uint64_t)chunkIndex));
+
+    // Per cell: set label of the current row. Labels stay below `cells` because
+    // they are renumbered after every row, so the union-find arrays stay O(width).
+    std::vector<int> label(cells);
+    std::vector<int> nextLabel(cells);
+    std::vector<int> parent(cells);
+    std::vector<int> members(cells);
+    std::vector<int> pick(cells);
+    std::vector<int> remap(cells);
+    std::vector<char> hasDown(cells);
+    std::vector<char> down(cells);
+
+    auto findRoot = [&](int l) {
+        while (parent[l] != l) {
+            parent[l] = parent[parent[l]];
+            l = parent[l];
+        }
+        return l;
+    };
+
+    for (int c = 0; c < cells; c++) {
+        label[c] = c;
+        parent[c] = c;
+    }
+
+    for (int r = 0; r < cellRows; r++) {
+        int z = 2 * r + 1;
+        bool lastRow = r == cellRows - 1;
+
+        for (int c = 0; c < cells; c++) {
+            grid.setOpen(2 * c + 1, z);
+        }
+
+        // Randomly join neighbours from different sets (always on the last row)
+        for (int c = 0; c + 1 < cells; c++) {
+            int a = findRoot(label[c]);
+            int b = findRoot(label[c + 1]);
+            if (a != b && (lastRow || rng() % 2 == 0)) {
+                parent[a] = b;
+                grid.setOpen(2 * c + 2, z);
+            }
+        }
+        if (lastRow) {
+            break;
+        }
+
+        // Carve down from a random subset of each set, at least one cell per set
+        for (int c = 0; c < cells; c++) {
+            members[c] = 0;
+            hasDown[c] = 0;
+        }
+        for (int c = 0; c < cells; c++) {
+            int root = findRoot(label[c]);
+            members[root]++;
+            down[c] = rng() % 2 == 0;
+            hasDown[root] |= down[c];
+        }
+        for (int c = 0; c < cells; c++) {
+            int root = findRoot(label[c]);
+            if (!hasDown[root] && members[root] > 0) {
+                pick[root] = (int)(rng() % members[root]);
+                members[root] = 0;      // reused below as a running member count
+            }
+        }
+        for (int c = 0; c < cells; c++) {
+            int root = findRoot(label[c]);
+            if (!hasDown[root] && members[root]++ == pick[root]) {
+                down[c] = 1;
+            }
+        }
+
+        // Cells carried down keep their set, the rest of the next row starts fresh
+        for (int c = 0; c < cells; c++) {
+            remap[c] = -1;
+        }
+        int labels = 0;
+        for (int c = 0; c < cells; c++) {
+            if (down[c]) {
+                grid.setOpen(2 * c + 1, z + 1);
+                int root = findRoot(label[c]);
+                if (remap[root] < 0) {
+                    remap[root] = labels++;
+                }
+                nextLabel[c] = remap[root];
+            }
+        }
+        for (int c = 0; c < cells; c++) {
+            if (!down[c]) {
+                nextLabel[c] = labels++;
+            }
+        }
+        label.swap(nextLabel);
+        for (int c = 0; c < cells; c++) {
+            parent[c] = c;
+        }
+    }
+
+    // One passage through the seam row into the previous chunk
+    int seamCell = (int)(mixSeed(mazeSeed ^ 0x5ea3u, (uint64_t)chunkIndex) % cells);
+    grid.setOpen(2 * seamCell + 1, 0);
+
+    // Extra openings only on rows whose neighbours are inside this chunk
+    for (int j = 2; j < ENDLESS_CHUNK_ROWS - 1; j++) {
+        addExtraOpenings(grid, MAZE_SIZE, j, 1, ENDLESS_CHUNK_ROWS - 1, EXTRA_OPENING_PERCENT, rng);
+    }
+}
+
+// Chunk lookup through the bounded LRU cache, regenerating evicted chunks
+static const MazeGrid& endlessChunk(int64_t chunkIndex)
+{
+    endlessClock++;
+    for (EndlessChunk& chunk : endlessCache) {
+        if (chunk.index == chunkIndex) {
+            chunk.lastUsed = endlessClock;
+            return chunk.grid;
+        }
+    }
+
+    EndlessChunk* slot = nullptr;
+    if ((int)endlessCache.size() < ENDLESS_CACHE_CHUNKS) {
+        endlessCache.emplace_back();
+        slot = &endlessCache.back();
+    }
+    else {
+        slot = &endlessCache[0];
+        for (EndlessChunk& chunk : endlessCache) {
+            if (chunk.lastUsed < slot->lastUsed) {
+                slot = &chunk;
+            }
+        }
+    }
+
+    slot->index = chunkIndex;
+    slot->lastUsed = endlessClock;
+    generateEndlessChunk(chunkIndex, slot->grid);
+    endlessChunksGenerated++;
+    return slot->grid;
+}
+
+// Keep the player inside the middle of the window. When they get close to
+// either end, the window slides by whole chunks, playerZ is rebased by the same
+// amount (so floats stay small however far they walk) and the rows are copied
+// in from the chunk cache word by word.
+void updateEndlessWindow(bool force)
+{
+    int playerChunk = (int)floor(playerZ + 0.5f) / ENDLESS_CHUNK_ROWS;
+    if (!force && playerChunk >= 2 && playerChunk < ENDLESS_WINDOW_CHUNKS - 2) {
+        return;
+    }
+
+    int64_t newWindowChunk = force ? endlessWindowChunk : endlessWindowChunk + playerChunk - ENDLESS_WINDOW_CHUNKS / 2;
+    playerZ -= (float)((newWindowChunk - endlessWindowChunk) * ENDLESS_CHUNK_ROWS);
+    endlessWindowChunk = newWindowChunk;
+
+    maze.resize(MAZE_SIZE + 2, ENDLESS_WINDOW_CHUNKS * ENDLESS_CHUNK_ROWS, true);
+    for (int w = 0; w < ENDLESS_WINDOW_CHUNKS; w++) {
+        const MazeGrid& chunk = endlessChunk(endlessWindowChunk + w);
+        for (int r = 0; r < ENDLESS_CHUNK_ROWS; r++) {
+            std::copy(chunk.row(r), chunk.row(r) + chunk.wordsPerRow(), maze.row(w * ENDLESS_CHUNK_ROWS + r));
+        }
+    }
+}
+
+// Fill the window around chunk 0 for a maze of the given width, false (with a
+// message) when there is no such maze
+bool startEndlessMaze(int width, unsigned int seed)
+{
+    if (width < 1) {
+        std::cout << "The endless maze needs a width of at least 1, not " << width << std::endl;
+        return false;
+    }
+    MAZE_SIZE = width;
+    mazeSeed = seed;
+
+    endlessCache.reserve(ENDLESS_CACHE_CHUNKS);
+
+    // Global chunk 0 starts at row 0, put it in the middle of the window
+    endlessWindowChunk = -ENDLESS_WINDOW_CHUNKS / 2;
+    playerZ += (float)(ENDLESS_WINDOW_CHUNKS / 2 * ENDLESS_CHUNK_ROWS);
+    updateEndlessWindow(true);
+    return true;
+}
+
+// Bit-parallel flood fill over the packed grid. Reached cells are kept as bit
+// sets in MazeGrid's word layout (bit x & 63 of word x >> 6 in row z) and grow
+// a whole word at a time: along a row with Kogge-Stone shift/AND fills, between
+// rows with a plain AND against the open cells. That is 64 cells per operation,
+// 256 when the row pass runs on AVX2.
+// Grow seeds through the set bits of open towards bit 63 / towards bit 0
+static inline uint64_t fillTowardsHigh(uint64_t seeds, uint64_t open)
+{
+    seeds |= (seeds << 1) & open;  open &= open << 1;
+    seeds |= (seeds << 2) & open;  open &= open << 2;
+    seeds |= (seeds << 4) & open;  open &= open << 4;
+    seeds |= (seeds << 8) & open;  open &= open << 8;
+    seeds |= (seeds << 16) & open; open &= open << 16;
+    seeds |= (seeds << 32) & open;
+    return seeds;
+}
+
+static inline uint64_t fillTowardsLow(uint64_t seeds, uint64_t open)
+{
+    seeds |= (seeds >> 1) & open;  open &= open >> 1;
+    seeds |= (seeds >> 2) & open;  open &= open >> 2;
+    seeds |= (seeds >> 4) & open;  open &= open >> 4;
+    seeds |= (seeds >> 8) & open;  open &= open >> 8;
+    seeds |= (seeds >> 16) & open; open &= open >> 16;
+    seeds |= (seeds >> 32) & open;
+    return seeds;
+}
+
+#if defined(__AVX2__)
+// Same fills on four words at once
+static inline __m256i fillTowardsHigh4(__m256i seeds, __m256i open)
+{
+#define FLOOD_STEP4(n) \
+    seeds = _mm256_or_si256(seeds, _mm256_and_si256(_mm256_slli_epi64(seeds, n), open)); \
+    open = _mm256_and_si256(open, _mm256_slli_epi64(open, n));
+    FLOOD_STEP4(1) FLOOD_STEP4(2) FLOOD_STEP4(4) FLOOD_STEP4(8) FLOOD_STEP4(16)
+#undef FLOOD_STEP4
+    return _mm256_or_si256(seeds, _mm256_and_si256(_mm256_slli_epi64(seeds, 32), open));
+}
+
+static inline __m256i fillTowardsLow4(__m256i seeds, __m256i open)
+{
+#define FLOOD_STEP4(n) \
+    seeds = _mm256_or_si256(seeds, _mm256_and_si256(_mm256_srli_epi64(seeds, n), open)); \
+    open = _mm256_and_si256(open, _mm256_srli_epi64(open, n));
+    FLOOD_STEP4(1) FLOOD_STEP4(2) FLOOD_STEP4(4) FLOOD_STEP4(8) FLOOD_STEP4(16)
+#undef FLOOD_STEP4
+    return _mm256_or_si256(seeds, _mm256_and_si256(_mm256_srli_epi64(seeds, 32), open));
+}
+#endif
+
+// Add the cells of the neighbouring row that are open in this row, then grow
+// every open run holding a reached cell to its full length. Returns true when
+// the row changed.
+static bool floodRow(uint64_t* reached, const uint64_t* neighbor, const uint64_t* walls, int words)
+{
+    uint64_t changed = 0;
+    int w = 0;
+
+#if defined(__AVX2__)
+    __m256i changedLanes = _mm256_setzero_si256();
+    for (; w + 4 <= words; w += 4) {
+        __m256i open = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i*)(walls + w)), _mm256_set1_epi64x(-1));
+        __m256i before = _mm256_loadu_si256((const __m256i*)(reached + w));
+        __m256i seeds = _mm256_and_si256(_mm256_or_si256(before, _mm256_loadu_si256((const __m256i*)(neighbor + w))), open);
+        __m256i after = fillTowardsHigh4(fillTowardsLow4(seeds, open), open);
+        _mm256_storeu_si256((__m256i*)(reached + w), after);
+        changedLanes = _mm256_or_si256(changedLanes, _mm256_xor_si256(after, before));
+    }
+    changed = !_mm256_testz_si256(changedLanes, changedLanes);
+#endif
+
+    for (; w < words; w++) {
+        uint64_t open = ~walls[w];
+        uint64_t after = fillTowardsHigh(fillTowardsLow((reached[w] | neighbor[w]) & open, open), open);
+        changed |= after ^ reached[w];
+        reached[w] = after;
+    }
+
+    // Runs that carry on into the next or previous word
+    for (w = 1; w < words; w++) {
+        uint64_t open = ~walls[w];
+        if ((reached[w - 1] >> 63) & open & ~reached[w] & 1) {
+            reached[w] = fillTowardsHigh(reached[w] | 1, open);
+            changed = 1;
+        }
+    }
+    for (w = words - 2; w >= 0; w--) {
+        uint64_t open = ~walls[w];
+        if ((reached[w + 1] << 63) & open & ~reached[w]) {
+            reached[w] = fillTowardsLow(reached[w] | (1ull << 63), open);
+            changed = 1;
+        }
+    }
+
+    return changed != 0;
+}
+
+// Sweep down and back up over the rows until nothing changes. Only the band of
+// rows holding reached cells (plus one row either side) is visited, and the
+// band is returned so callers can limit their own passes to it.
+static void floodSweep(const MazeGrid& grid, uint64_t* reached, int& firstRow, int& lastRow)
+{
+    int words = grid.wordsPerRow();
+    int height = grid.height();
+
+    // The border rows are all wall, so row z - 1 and z + 1 always exist
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int z = std::max(1, firstRow); z <= std::min(height - 2, lastRow + 1); z++) {
+            if (floodRow(reached + (size_t)z * words, reached + (size_t)(z - 1) * words, grid.row(z), words)) {
+                changed = true;
+                lastRow = std::max(lastRow, z);
+            }
+        }
+        for (int z = std::min(height - 2, lastRow); z >= std::max(1, firstRow - 1); z--) {
+            if (floodRow(reached + (size_t)z * words, reached + (size_t)(z + 1) * words, grid.row(z), words)) {
+                changed = true;
+                firstRow = std::min(firstRow, z);
+            }
+        }
+    }
+}
+
+// Every open cell connected to (startX, startZ)
+void floodReachable(const MazeGrid& grid, int startX, int startZ, std::vector<uint64_t>& reached)
+{
+    reached.assign(grid.wordCount(), 0);
+    if (grid.isWall(startX, startZ)) {
+        return;
+    }
+
+    reached[(size_t)startZ * grid.wordsPerRow() + (startX >> 6)] |= 1ull << (startX & 63);
+    int firstRow = startZ;
+    int lastRow = startZ;
+    floodSweep(grid, reached.data(), firstRow, lastRow);
+}
+
+// Breadth-first layers from (startX, startZ). Only the words on the current
+// frontier are touched, and each grows by one step per layer with shifts. Fills
+// distance (if given) with the layer of every cell, FLOOD_UNREACHABLE elsewhere.
+// Stops early once target (a packed cell index, or -1) is reached and returns
+// its layer; with no target it returns the number of the last layer.
+struct FloodWord {
+    uint32_t index;     // word index in the grid layout
+    uint64_t bits;
+};
+
+static uint32_t floodLayerSearch(const MazeGrid& grid, int startX, int startZ, int64_t target, std::vector<uint32_t>* distance)
+{
+    int width = grid.width();
+    int words = grid.wordsPerRow();
+    const uint64_t* walls = grid.data();
+
+    std::vector<uint64_t> visited(grid.wordCount(), 0);
+    std::vector<uint64_t> pending(grid.wordCount(), 0);
+    std::vector<FloodWord> frontier;
+    std::vector<FloodWord> next;
+    std::vector<uint32_t> touched;
+
+    if (distance) {
+        distance->assign((size_t)width * grid.height(), FLOOD_UNREACHABLE);
+    }
+    if (grid.isWall(startX, startZ)) {
+        return FLOOD_UNREACHABLE;
+    }
+
+    uint32_t startWord = (uint32_t)startZ * words + (startX >> 6);
+    uint64_t startBit = 1ull << (startX & 63);
+    visited[startWord] = startBit;
+    frontier.push_back({ startWord, startBit });
+    if (distance) {
+        (*distance)[(size_t)startZ * width + startX] = 0;
+    }
+    if (target == (int64_t)startZ * width + startX) {
+        return 0;
+    }
+
+    int64_t targetWord = target >= 0 ? (target / width) * words + (target % width >> 6) : -1;
+    uint64_t targetBit = target >= 0 ? 1ull << (target % width & 63) : 0;
+
+    auto add = [&](uint32_t index, uint64_t bits) {
+        if (pending[index] == 0) {
+            touched.push_back(index);
+        }
+        pending[index] |= bits;
+    };
+
+    uint32_t layer = 0;
+    while (!frontier.empty()) {
+        layer++;
+
+        // Neighbours of the frontier: along the word, across word edges, up and down
+        // (the border is all wall, so none of these leave the grid)
+        touched.clear();
+        for (const FloodWord& word : frontier) {
+            add(word.index, (word.bits << 1) | (word.bits >> 1));
+            if (word.bits >> 63) {
+                add(word.index + 1, 1);
+            }
+            if (word.bits & 1) {
+                add(word.index - 1, 1ull << 63);
+            }
+            add(word.index - words, word.bits);
+            add(word.index + words, word.bits);
+        }
+
+        next.clear();
+        for (uint32_t index : touched) {
+            uint64_t fresh = pending[index] & ~walls[index] & ~visited[index];
+            pending[index] = 0;
+            if (fresh == 0) {
+                continue;
+            }
+            visited[index] |= fresh;
+            next.push_back({ index, fresh });
+
+            if (distance) {
+                uint32_t* row = distance->data() + (size_t)(index / words) * width + (size_t)(index % words) * 64;
+                for (uint64_t bits = fresh; bits; bits &= bits - 1) {
+                    row[__builtin_ctzll(bits)] = layer;
+                }
+            }
+        }
+
+        if (targetWord >= 0 && (visited[targetWord] & targetBit)) {
+            return layer;
+        }
+        frontier.swap(next);
+    }
+
+    return target >= 0 ? FLOOD_UNREACHABLE : layer - 1;
+}
+
+uint32_t floodLayers(const MazeGrid& grid, int startX, int startZ, std::vector<uint32_t>& distance)
+{
+    return floodLayerSearch(grid, startX, startZ, -1, &distance);
+}
+
+// Shortest path length in steps, FLOOD_UNREACHABLE when there is none
+uint32_t floodDistance(const MazeGrid& grid, int startX, int startZ, int targetX, int targetZ)
+{
+    if (grid.isWall(targetX, targetZ)) {
+        return FLOOD_UNREACHABLE;
+    }
+    return floodLayerSearch(grid, startX, startZ, (int64_t)targetZ * grid.width() + targetX, nullptr);
+}
+
+// Connected components of the open cells. label gets 0 for walls and 1, 2, ...
+// for the component of each open cell, in order of their first cell. Returns
+// the number of components.
+uint32_t floodComponents(const MazeGrid& grid, std::vector<uint32_t>& label)
+{
+    int width = grid.width();
+    int words = grid.wordsPerRow();
+    const uint64_t* walls = grid.data();
+
+    label.assign((size_t)width * grid.height(), 0);
+    std::vector<uint64_t> assigned(grid.wordCount(), 0);
+    std::vector<uint64_t> reached(grid.wordCount(), 0);
+    uint32_t components = 0;
+
+    for (size_t seedWord = 0; seedWord < assigned.size(); seedWord++) {
+        while (uint64_t unassigned = ~walls[seedWord] & ~assigned[seedWord]) {
+            int firstRow = (int)(seedWord / words);
+            int lastRow = firstRow;
+            reached[seedWord] = unassigned & (~unassigned + 1);
+            floodSweep(grid, reached.data(), firstRow, lastRow);
+            components++;
+
+            // Label the new component and clear the scratch set behind it
+            for (int z = firstRow; z <= lastRow; z++) {
+                for (int w = 0; w < words; w++) {
+                    size_t index = (size_t)z * words + w;
+                    uint64_t bits = reached[index];
+                    if (bits == 0) {
+                        continue;
+                    }
+                    assigned[index] |= bits;
+                    reached[index] = 0;
+                    uint32_t* row = label.data() + (size_t)z * width + (size_t)w * 64;
+                    for (; bits; bits &= bits - 1) {
+                        row[__builtin_ctzll(bits)] = components;
+                    }
+                }
+            }
+        }
+    }
+
+    return components;
+}
+
+// BFS over the open cells from (goalX, goalZ). Walls are marked in the field
+// first, so the search only ever reads the field itself, and the border is all
+// wall, so the neighbours of an open cell never need a bounds check. Returns
+// the number of cells that can reach the goal.
+size_t buildDistanceField(int goalX, int goalZ)
+{
+    return buildDistanceField(maze, solver, goalX, goalZ);
+}
+
+// The same into any solver state, for a maze that isn't the current one (the
+// next level, built in the background)
+size_t buildDistanceField(const MazeGrid& grid, MazeSolver& state, int goalX, int goalZ)
+{
+    int width = grid.width();
+    int height = grid.height();
+    size_t cellCount = (size_t)width * height;
+
+    state.distance.resize(cellCount);
+    if (state.queue.size() < cellCount) {
+        state.queue.resize(cellCount);
+    }
+    state.goalX = goalX;
+    state.goalZ = goalZ;
+
+    uint32_t* distance = state.distance.data();
+    for (int z = 0; z < height; z++) {
+        const uint64_t* row = grid.row(z);
+        uint32_t* out = distance + (size_t)z * width;
+        for (int x = 0; x < width; x++) {
+            out[x] = (row[x >> 6] >> (x & 63)) & 1 ? SOLVER_WALL : SOLVER_UNREACHABLE;
+        }
+    }
+    if (grid.isWall(goalX, goalZ)) {
+        return 0;
+    }
+
+    const int offsets[4] = { -1, 1, -width, width };
+    uint32_t* queue = state.queue.data();
+    size_t head = 0;
+    size_t tail = 0;
+
+    uint32_t goal = (uint32_t)goalZ * width + goalX;
+    distance[goal] = 0;
+    queue[tail++] = goal;
+
+    while (head < tail) {
+        uint32_t cell = queue[head++];
+        uint32_t next = distance[cell] + 1;
+        for (int n = 0; n < 4; n++) {
+            uint32_t neighbor = cell + offsets[n];
+            if (distance[neighbor] == SOLVER_UNREACHABLE) {
+                distance[neighbor] = next;
+                queue[tail++] = neighbor;
+            }
+        }
+    }
+
+    // Walls read as unreachable from here on
+    for (size_t cell = 0; cell < cellCount; cell++) {
+        if (distance[cell] == SOLVER_WALL) {
+            distance[cell] = SOLVER_UNREACHABLE;
+        }
+    }
+
+    return tail;
+}
+
+// Follow the distance field downhill from (x, z) for at most maxSteps cells.
+// Returns false when (x, z) can't reach the goal.
+bool followDistanceField(int x, int z, int maxSteps, std::vector<int>& path)
+{
+    path.clear();
+    int width = maze.width();
+    uint32_t cell = (uint32_t)z * width + x;
+    if (solver.distance.empty() || solver.distance[cell] == SOLVER_UNREACHABLE) {
+        return false;
+    }
+
+    const int offsets[4] = { -1, 1, -width, width };
+    path.push_back((int)cell);
+    while ((int)path.size() <= maxSteps && solver.distance[cell] > 0) {
+        for (int n = 0; n < 4; n++) {
+            uint32_t neighbor = cell + offsets[n];
+            if (solver.distance[neighbor] == solver.distance[cell] - 1) {
+                cell = neighbor;
+                break;
+            }
+        }
+        path.push_back((int)cell);
+    }
+    return true;
+}
+
+// A* from (startX, startZ) to (goalX, goalZ) with a Manhattan heuristic. On
+// success path holds the cells from start to goal.
+bool findPath(int startX, int startZ, int goalX, int goalZ, std::vector<int>& path)
+{
+    path.clear();
+    if (maze.isWall(startX, startZ) || maze.isWall(goalX, goalZ)) {
+        return false;
+    }
+
+    int width = maze.width();
+    size_t cellCount = (size_t)width * maze.height();
+    if (solver.stamp.size() < cellCount) {
+        solver.cost.resize(cellCount);
+        solver.parent.resize(cellCount);
+        solver.stamp.assign(cellCount, 0);
+        solver.searchStamp = 0;
+    }
+
+    // Stamps wrap after 4 billion searches - clear once and start over
+    if (++solver.searchStamp == 0) {
+        std::fill(solver.stamp.begin(), solver.stamp.end(), 0);
+        solver.searchStamp = 1;
+    }
+    uint32_t searchStamp = solver.searchStamp;
+
+    auto heuristic = [&](uint32_t cell) {
+        return (uint32_t)(abs((int)(cell % width) - goalX) + abs((int)(cell / width) - goalZ));
+    };
+    auto later = [](uint64_t a, uint64_t b) { return a > b; };
+
+    uint32_t start = (uint32_t)startZ * width + startX;
+    uint32_t goal = (uint32_t)goalZ * width + goalX;
+    solver.open.clear();
+    solver.cost[start] = 0;
+    solver.parent[start] = start;
+    solver.stamp[start] = searchStamp;
+    solver.open.push_back((uint64_t)heuristic(start) << 32 | start);
+
+    const int dx[4] = { -1, 1, 0, 0 };
+    const int dz[4] = { 0, 0, -1, 1 };
+    bool found = false;
+    while (!solver.open.empty()) {
+        std::pop_heap(solver.open.begin(), solver.open.end(), later);
+        uint64_t entry = solver.open.back();
+        solver.open.pop_back();
+
+        uint32_t cell = (uint32_t)entry;
+        if (cell == goal) {
+            found = true;
+            break;
+        }
+        // Stale entry - the cell was reached more cheaply after it was pushed
+        if ((uint32_t)(entry >> 32) != solver.cost[cell] + heuristic(cell)) {
+            continue;
+        }
+
+        uint32_t nextCost = solver.cost[cell] + 1;
+        int x = cell % width;
+        int z = cell / width;
+        for (int n = 0; n < 4; n++) {
+            if (maze.isWall(x + dx[n], z + dz[n])) {
+                continue;
+            }
+            uint32_t neighbor = cell + dz[n] * width + dx[n];
+            if (solver.stamp[neighbor] != searchStamp || nextCost < solver.cost[neighbor]) {
+                solver.stamp[neighbor] = searchStamp;
+                solver.cost[neighbor] = nextCost;
+                solver.parent[neighbor] = cell;
+                solver.open.push_back((uint64_t)(nextCost + heuristic(neighbor)) << 32 | neighbor);
+                std::push_heap(solver.open.begin(), solver.open.end(), later);
+            }
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+    for (uint32_t cell = goal; cell != start; cell = solver.parent[cell]) {
+        path.push_back((int)cell);
+    }
+    path.push_back((int)start);
+    std::reverse(path.begin(), path.end());
+    return true;
+}
+
+// Metrics of a size x size maze in grid (start (1, 1), goal (size, size)).
+// scratch holds the distance field and is reused from call to call.
+MazeMetrics measureMaze(const MazeGrid& grid, MazeSolver& scratch)
+{
+    MazeMetrics metrics;
+    int width = grid.width();
+    int height = grid.height();
+    int words = grid.wordsPerRow();
+    int size = width - 2;
+
+    // Bit-sliced count of the open neighbours of all 64 cells of a word at once:
+    // every neighbour mask goes through a small adder into bits c0, c1, c2 of
+    // the count. Border rows and the padding are wall, so rows 1 .. height - 2
+    // see everything they need and nothing leaks in from outside.
+    uint64_t passages = 0;
+    uint64_t junctionExits = 0;
+    for (int z = 1; z < height - 1; z++) {
+        const uint64_t* row = grid.row(z);
+        const uint64_t* above = grid.row(z - 1);
+        const uint64_t* below = grid.row(z + 1);
+        for (int w = 0; w < words; w++) {
+            uint64_t open = ~row[w];
+            if (open == 0) {
+                continue;
+            }
+            uint64_t left = open << 1 | (w > 0 ? ~row[w - 1] >> 63 : 0);
+            uint64_t right = open >> 1 | (w + 1 < words ? ~row[w + 1] << 63 : 0);
+            uint64_t up = ~above[w];
+            uint64_t down = ~below[w];
+
+            uint64_t c0 = left ^ right;
+            uint64_t c1 = left & right;
+            uint64_t carry = c0 & up;
+            c0 ^= up;
+            uint64_t c2 = c1 & carry;
+            c1 ^= carry;
+            carry = c0 & down;
+            c0 ^= down;
+            c2 |= c1 & carry;
+            c1 ^= carry;
+
+            uint64_t threeExits = open & c0 & c1;
+            uint64_t fourExits = open & c2;
+            metrics.openCells += __builtin_popcountll(open);
+            metrics.deadEnds += __builtin_popcountll(open & c0 & ~c1 & ~c2);
+            metrics.junctions += __builtin_popcountll(threeExits | fourExits);
+            junctionExits += 3 * __builtin_popcountll(threeExits) + 4 * __builtin_popcountll(fourExits);
+
+            // Each passage counted once, from its left or upper cell
+            passages += __builtin_popcountll(open & right) + __builtin_popcountll(open & down);
+        }
+    }
+    metrics.branchingFactor = metrics.junctions > 0 ? (float)junctionExits / metrics.junctions : 0.0f;
+
+    // Generated mazes are connected, which the distance field shows without a
+    // component search; anything else gets one
+    size_t reachable = buildDistanceField(grid, scratch, size, size);
+    uint32_t components = 1;
+    if (reachable != metrics.openCells) {
+        std::vector<uint32_t> label;
+        components = floodComponents(grid, label);
+    }
+    metrics.loops = (uint32_t)(passages + components - metrics.openCells);
+
+    // Walk the solution down the field, counting the junctions passed on the way
+    const uint32_t* distance = scratch.distance.data();
+    uint32_t cell = (uint32_t)width + 1;
+    metrics.solutionLength = distance[cell];
+    if (metrics.solutionLength == SOLVER_UNREACHABLE) {
+        return metrics;
+    }
+    const int offsets[4] = { -1, 1, -width, width };
+    while (distance[cell] > 0) {
+        uint32_t next = cell;
+        int exits = 0;
+        for (int n = 0; n < 4; n++) {
+            uint32_t neighbor = cell + offsets[n];
+            if (distance[neighbor] != SOLVER_UNREACHABLE) {
+                exits++;
+                if (distance[neighbor] == distance[cell] - 1) {
+                    next = neighbor;
+                }
+            }
+        }
+        metrics.decisionPoints += exits >= 3;
+        cell = next;
+    }
+    return metrics;
+}
+
+// Light of a corner with 0 to 3 of the cells around it walls. Two walls on
+// the sides close the corner off whatever the diagonal is.
+static const float ambientOcclusionLevels[4] = { 1.0f, 0.8f, 0.65f, 0.5f };
+static const float lanternColor[3] = { 1.0f, 0.75f, 0.45f };
+
+// Whether the segment from the centre of cell (fromX, fromZ) to (toX, toZ)
+// only crosses open cells (a DDA walk, as the raycaster's)
+static bool lineOfSight(const MazeGrid& grid, int fromX, int fromZ, float toX, float toZ)
+{
+    float dirX = toX - fromX;
+    float dirZ = toZ - fromZ;
+    int cellX = fromX;
+    int cellZ = fromZ;
+    int endX = (int)(toX + 0.5f);
+    int endZ = (int)(toZ + 0.5f);
+    int stepX = dirX < 0.0f ? -1 : 1;
+    int stepZ = dirZ < 0.0f ? -1 : 1;
+    float deltaX = dirX != 0.0f ? fabsf(1.0f / dirX) : 1e30f;
+    float deltaZ = dirZ != 0.0f ? fabsf(1.0f / dirZ) : 1e30f;
+    float sideX = 0.5f * deltaX;    // the segment starts at a cell centre
+    float sideZ = 0.5f * deltaZ;
+    while (cellX != endX || cellZ != endZ) {
+        if (sideX < sideZ) {
+            if (sideX > 1.0f) {
+                break;
+            }
+            sideX += deltaX;
+            cellX += stepX;
+        }
+        else {
+            if (sideZ > 1.0f) {
+                break;
+            }
+            sideZ += deltaZ;
+            cellZ += stepZ;
+        }
+        if (grid.isWall(cellX, cellZ)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// One lantern per LANTERN_SPACING block of the inside of the maze, on a random
+// open cell of the block (blocks with no open cell found in a few tries get none)
+void placeLanterns(const MazeGrid& grid, unsigned int seed, MazeLighting& lighting)
+{
+    lighting.lanternX.clear();
+    lighting.lanternZ.clear();
+    std::mt19937 rng(seed ^ 0x4C414D50u);
+    int size = grid.width() - 2;
+    for (int blockZ = 1; blockZ <= size; blockZ += LANTERN_SPACING) {
+        for (int blockX = 1; blockX <= size; blockX += LANTERN_SPACING) {
+            std::uniform_int_distribution<int> pickX(blockX, std::min(size, blockX + LANTERN_SPACING - 1));
+            std::uniform_int_distribution<int> pickZ(blockZ, std::min(size, blockZ + LANTERN_SPACING - 1));
+            for (int attempt = 0; attempt < 8; attempt++) {
+                int x = pickX(rng);
+                int z = pickZ(rng);
+                if (!grid.isWall(x, z)) {
+                    lighting.lanternX.push_back(x);
+                    lighting.lanternZ.push_back(z);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Bake the corner light of every open cell of grid, a row of cells per job on
+// the worker pool. Lanterns are looked up by block, so a cell only tries the
+// few whose block is within LANTERN_RANGE.
+void bakeLighting(const MazeGrid& grid, unsigned int seed, MazeLighting& lighting)
+{
+    int width = grid.width();
+    int height = grid.height();
+    placeLanterns(grid, seed, lighting);
+    lighting.width = width;
+    lighting.height = height;
+    lighting.light.assign((size_t)width * height * 8, 0);
+
+    int blocksX = (width - 2 + LANTERN_SPACING - 1) / LANTERN_SPACING;
+    int blocksZ = (height - 2 + LANTERN_SPACING - 1) / LANTERN_SPACING;
+    std::vector<int32_t> blockLantern((size_t)blocksX * blocksZ, -1);
+    for (size_t l = 0; l < lighting.lanternX.size(); l++) {
+        int blockX = (lighting.lanternX[l] - 1) / LANTERN_SPACING;
+        int blockZ = (lighting.lanternZ[l] - 1) / LANTERN_SPACING;
+        blockLantern[(size_t)blockZ * blocksX + blockX] = (int32_t)l;
+    }
+    int reach = (int)ceilf(LANTERN_RANGE) + 1;
+
+    workerPool().parallelFor(1, height - 1, [&](int z) {
+        int32_t nearby[16];
+        for (int x = 1; x < width - 1; x++) {
+            if (grid.isWall(x, z)) {
+                continue;
+            }
+
+            // Lanterns that can reach some part of the cell
+            int nearbyCount = 0;
+            int firstBlockX = std::max(0, (x - reach - 1) / LANTERN_SPACING);
+            int lastBlockX = std::min(blocksX - 1, (x + reach - 1) / LANTERN_SPACING);
+            int firstBlockZ = std::max(0, (z - reach - 1) / LANTERN_SPACING);
+            int lastBlockZ = std::min(blocksZ - 1, (z + reach - 1) / LANTERN_SPACING);
+            for (int blockZ = firstBlockZ; blockZ <= lastBlockZ; blockZ++) {
+                for (int blockX = firstBlockX; blockX <= lastBlockX; blockX++) {
+                    int32_t l = blockLantern[(size_t)blockZ * blocksX + blockX];
+                    if (l >= 0 && nearbyCount < 16 && abs(lighting.lanternX[l] - x) < reach
+                        && abs(lighting.lanternZ[l] - z) < reach) {
+                        nearby[nearbyCount++] = l;
+                    }
+                }
+            }
+
+            uint32_t* out = &lighting.light[((size_t)z * width + x) * 8];
+            for (int corner = 0; corner < 4; corner++) {
+                int sideX = corner & 1 ? 1 : -1;
+                int sideZ = corner & 2 ? 1 : -1;
+                bool wallX = grid.isWall(x + sideX, z);
+                bool wallZ = grid.isWall(x, z + sideZ);
+                int occluders = wallX && wallZ ? 3 : wallX + wallZ + grid.isWall(x + sideX, z + sideZ);
+                float ambient = LIGHT_AMBIENT * ambientOcclusionLevels[occluders];
+                float rgb[2][3] = { { ambient, ambient, ambient }, { ambient, ambient, ambient } };
+
+                // Sample just inside the corner, so rays to it don't graze the
+                // walls. The floor and the ceiling share the ray.
+                float sampleX = x + 0.45f * sideX;
+                float sampleZ = z + 0.45f * sideZ;
+                for (int n = 0; n < nearbyCount; n++) {
+                    int lanternX = lighting.lanternX[nearby[n]];
+                    int lanternZ = lighting.lanternZ[nearby[n]];
+                    float dx = sampleX - lanternX;
+                    float dz = sampleZ - lanternZ;
+                    float across = dx * dx + dz * dz;
+                    if (across >= LANTERN_RANGE * LANTERN_RANGE || !lineOfSight(grid, lanternX, lanternZ, sampleX, sampleZ)) {
+                        continue;
+                    }
+                    for (int level = 0; level < 2; level++) {
+                        float dy = level - LANTERN_HEIGHT;
+                        float falloff = std::max(0.0f, 1.0f - sqrtf(across + dy * dy) / LANTERN_RANGE);
+                        for (int c = 0; c < 3; c++) {
+                            rgb[level][c] += LANTERN_INTENSITY * falloff * falloff * lanternColor[c];
+                        }
+                    }
+                }
+
+                for (int level = 0; level < 2; level++) {
+                    uint32_t packed = 0xFF000000u;
+                    for (int c = 0; c < 3; c++) {
+                        packed |= (uint32_t)std::min(255L, std::lround(rgb[level][c] * LIGHT_ONE)) << (8 * c);
+                    }
+                    out[level * 4 + corner] = packed;
+                }
+            }
+        }
+    });
+}
+
+static inline uint32_t agentRandom(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Put agents on random open cells, a chaserFraction share of them chasers
+void spawnAgents(AgentSet& set, size_t count, float chaserFraction, unsigned int seed)
+{
+    set = AgentSet();
+    set.count = count;
+    set.x.resize(count);
+    set.z.resize(count);
+    set.dirX.assign(count, 0.0f);
+    set.dirZ.assign(count, 0.0f);
+    set.speed.resize(count);
+    set.targetX.resize(count);
+    set.targetZ.resize(count);
+    set.kind.resize(count);
+    set.rng.resize(count);
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> column(1, maze.width() - 2);
+    std::uniform_int_distribution<int> row(1, maze.height() - 2);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t i = 0; i < count; i++) {
+        int cellX, cellZ;
+        do {
+            cellX = column(rng);
+            cellZ = row(rng);
+        } while (maze.isWall(cellX, cellZ));
+
+        // Standing on its own cell centre, so the first update picks a direction
+        set.x[i] = (float)cellX;
+        set.z[i] = (float)cellZ;
+        set.targetX[i] = cellX;
+        set.targetZ[i] = cellZ;
+        set.speed[i] = AGENT_MIN_SPEED + (AGENT_MAX_SPEED - AGENT_MIN_SPEED) * unit(rng);
+        set.kind[i] = unit(rng) < chaserFraction ? AGENT_CHASER : AGENT_WANDERER;
+        set.rng[i] = (uint32_t)mixSeed(seed, i) | 1u;
+        set.chasers += set.kind[i] == AGENT_CHASER;
+    }
+}
+
+// Next cell for agent i, which stands on the centre of (cellX, cellZ)
+static void retargetAgent(AgentSet& set, size_t i, int cellX, int cellZ)
+{
+    static const int stepX[4] = { 1, -1, 0, 0 };
+    static const int stepZ[4] = { 0, 0, 1, -1 };
+
+    // Chasers walk downhill on the field while they can reach the player at all
+    size_t width = (size_t)maze.width();
+    bool chasing = set.kind[i] == AGENT_CHASER && !set.chaseField.empty()
+                   && set.chaseField[cellZ * width + cellX] != FLOOD_UNREACHABLE;
+    int choice = -1;
+    if (chasing) {
+        uint32_t best = set.chaseField[cellZ * width + cellX];
+        for (int d = 0; d < 4; d++) {
+            uint32_t distance = set.chaseField[(cellZ + stepZ[d]) * width + cellX + stepX[d]];
+            if (distance < best) {
+                best = distance;
+                choice = d;
+            }
+        }
+    }
+    else {
+        // Random open neighbour, but not straight back unless it's a dead end
+        bool moving = set.dirX[i] != 0.0f || set.dirZ[i] != 0.0f;
+        int open[4];
+        int openCount = 0;
+        int back = -1;
+        for (int d = 0; d < 4; d++) {
+            if (maze.isWall(cellX + stepX[d], cellZ + stepZ[d])) {
+                continue;
+            }
+            if (moving && stepX[d] == -(int)set.dirX[i] && stepZ[d] == -(int)set.dirZ[i]) {
+                back = d;
+                continue;
+            }
+            open[openCount++] = d;
+        }
+        choice = openCount > 0 ? open[agentRandom(set.rng[i]) % openCount] : back;
+    }
+
+    // Chasers that caught up (and walled-in agents) stay put
+    if (choice < 0) {
+        set.targetX[i] = cellX;
+        set.targetZ[i] = cellZ;
+        set.dirX[i] = set.dirZ[i] = 0.0f;
+        return;
+    }
+    set.targetX[i] = cellX + stepX[choice];
+    set.targetZ[i] = cellZ + stepZ[choice];
+    set.dirX[i] = (float)stepX[choice];
+    set.dirZ[i] = (float)stepZ[choice];
+}
+
+// Agents [begin, end) by dt seconds
+static void updateAgentBatch(AgentSet& set, size_t begin, size_t end, float dt)
+{
+    float nextX[AGENT_BATCH];
+    float nextZ[AGENT_BATCH];
+    uint8_t arrived[AGENT_BATCH];
+    size_t n = end - begin;
+    float* x = &set.x[begin];
+    float* z = &set.z[begin];
+    const float* dirX = &set.dirX[begin];
+    const float* dirZ = &set.dirZ[begin];
+    const float* speed = &set.speed[begin];
+    const int32_t* targetX = &set.targetX[begin];
+    const int32_t* targetZ = &set.targetZ[begin];
+
+    // Move towards the target, stopping on it - no branches, so it vectorizes.
+    // Agents only move along one axis, so the distance left is |dx| + |dz|.
+    for (size_t i = 0; i < n; i++) {
+        float left = fabsf((float)targetX[i] - x[i]) + fabsf((float)targetZ[i] - z[i]);
+        float step = std::min(speed[i] * dt, left);
+        nextX[i] = x[i] + dirX[i] * step;
+        nextZ[i] = z[i] + dirZ[i] * step;
+        arrived[i] = speed[i] * dt >= left;
+    }
+
+    // Grid collision of the centre point, then commit, retargeting on arrival
+    int width = maze.width();
+    int height = maze.height();
+    for (size_t i = 0; i < n; i++) {
+        int gridX = (int)(nextX[i] + 0.5f);
+        int gridZ = (int)(nextZ[i] + 0.5f);
+        bool blocked = gridX < 0 || gridX >= width || gridZ < 0 || gridZ >= height || maze.isWall(gridX, gridZ);
+        if (!blocked) {
+            x[i] = nextX[i];
+            z[i] = nextZ[i];
+        }
+        if (arrived[i] || blocked) {
+            // Blocked agents go back to the centre they came from and choose again
+            int cellX = arrived[i] && !blocked ? targetX[i] : (int)(x[i] + 0.5f);
+            int cellZ = arrived[i] && !blocked ? targetZ[i] : (int)(z[i] + 0.5f);
+            x[i] = (float)cellX;
+            z[i] = (float)cellZ;
+            retargetAgent(set, begin + i, cellX, cellZ);
+        }
+    }
+}
+
+// One tick of every agent. Chasers head for the cell of (targetX, targetZ).
+void updateAgents(AgentSet& set, float dt, float targetX, float targetZ)
+{
+    PROFILE_SCOPE(PROFILE_UPDATE_AGENTS);
+
+    if (set.count == 0) {
+        return;
+    }
+
+    int cellX = (int)(targetX + 0.5f);
+    int cellZ = (int)(targetZ + 0.5f);
+    if (set.chasers > 0 && (cellX != set.chaseCellX || cellZ != set.chaseCellZ)) {
+        floodLayers(maze, cellX, cellZ, set.chaseField);
+        set.chaseCellX = cellX;
+        set.chaseCellZ = cellZ;
+    }
+
+    int batches = (int)((set.count + AGENT_BATCH - 1) / AGENT_BATCH);
+    workerPool().parallelFor(0, batches, [&](int batch) {
+        size_t begin = (size_t)batch * AGENT_BATCH;
+        updateAgentBatch(set, begin, std::min(set.count, begin + AGENT_BATCH), dt);
+    });
+}
+
+void publishAgentSnapshot(const AgentSet& set, uint64_t tick)
+{
+    AgentSnapshot& snapshot = agentSnapshots.writeSlot();
+    snapshot.tick = tick;
+    snapshot.x.assign(set.x.begin(), set.x.end());
+    snapshot.z.assign(set.z.begin(), set.z.end());
+    snapshot.kind.assign(set.kind.begin(), set.kind.end());
+    agentSnapshots.publish();
+}
+
+// Lighting of the GL renderer (see init() in main.cpp): GL_LIGHT0 sits 15 units
+// above the eye, with 0.3 ambient and 0.7 diffuse, on top of the default 0.2
+// global ambient. Materials take their ambient and diffuse from the colour.
+const float RAYCAST_LAMP_HEIGHT = 15.0f;
+const float RAYCAST_AMBIENT = 0.2f + 0.3f;
+const float RAYCAST_DIFFUSE = 0.7f;
+const float RAYCAST_WALL_COLOR[3] = { 0.5f, 0.5f, 0.7f };
+const float RAYCAST_FLOOR_COLOR[3] = { 0.3f, 0.3f, 0.3f };
+const float RAYCAST_CEILING_COLOR[3] = { 0.2f, 0.2f, 0.2f };
+const float RAYCAST_BACKGROUND = 0.1f;          // glClearColor() beyond the far plane
+
+// color lit with cosine nDotL, packed as RGBA8
+static uint32_t raycastShade(const float* color, float nDotL)
+{
+    float light = RAYCAST_AMBIENT + RAYCAST_DIFFUSE * std::max(0.0f, nDotL);
+    uint32_t pixel = 0xFF000000u;
+    for (int c = 0; c < 3; c++) {
+        pixel |= (uint32_t)std::lround(std::min(1.0f, color[c] * light) * 255.0f) << (8 * c);
+    }
+    return pixel;
+}
+
+// One ray per column in [firstColumn, lastColumn). The ray for a column goes
+// through the centre of its pixels on the image plane one unit ahead, so the
+// DDA's side distances are already distances along the view direction.
+static void raycastColumns(const MazeGrid& grid, float posX, float posZ, float forwardX, float forwardZ, float eyeY,
+                           float focal, int firstColumn, int lastColumn, RaycastFrame& frame)
+{
+    int gridWidth = grid.width();
+    int gridHeight = grid.height();
+    float horizon = frame.height * 0.5f;
+
+    for (int column = firstColumn; column < lastColumn; column++) {
+        // Right is the view direction turned clockwise seen from above
+        float offset = (column + 0.5f - frame.width * 0.5f) / focal;
+        float dirX = forwardX - forwardZ * offset;
+        float dirZ = forwardZ + forwardX * offset;
+
+        int cellX = (int)floorf(posX);
+        int cellZ = (int)floorf(posZ);
+        int stepX = dirX < 0.0f ? -1 : 1;
+        int stepZ = dirZ < 0.0f ? -1 : 1;
+        float deltaX = dirX != 0.0f ? fabsf(1.0f / dirX) : 1e30f;
+        float deltaZ = dirZ != 0.0f ? fabsf(1.0f / dirZ) : 1e30f;
+        float sideX = (dirX < 0.0f ? posX - cellX : cellX + 1.0f - posX) * deltaX;
+        float sideZ = (dirZ < 0.0f ? posZ - cellZ : cellZ + 1.0f - posZ) * deltaZ;
+
+        float distance = RAYCAST_VIEW_DISTANCE;
+        bool hitX = false;
+        while (true) {
+            float travelled;
+            bool crossesX = sideX < sideZ;
+            if (crossesX) {
+                travelled = sideX;
+                sideX += deltaX;
+                cellX += stepX;
+            }
+            else {
+                travelled = sideZ;
+                sideZ += deltaZ;
+                cellZ += stepZ;
+            }
+            if (travelled > RAYCAST_VIEW_DISTANCE || cellX < 0 || cellX >= gridWidth || cellZ < 0 || cellZ >= gridHeight) {
+                break;
+            }
+            if (grid.isWall(cellX, cellZ)) {
+                distance = std::max(travelled, 1e-4f);
+                hitX = crossesX;
+                break;
+            }
+        }
+
+        if (distance >= RAYCAST_VIEW_DISTANCE) {
+            frame.wallTop[column] = frame.wallBottom[column] = (int32_t)horizon;
+            frame.wallColor[column] = 0;
+            frame.wallDistance[column] = RAYCAST_VIEW_DISTANCE;
+            continue;
+        }
+
+        // Rows whose centre lies between the projected top (y = 1) and bottom (y = 0)
+        float top = horizon - (1.0f - eyeY) * focal / distance;
+        float bottom = horizon + eyeY * focal / distance;
+        frame.wallTop[column] = (int32_t)std::max(0.0f, std::min((float)frame.height, ceilf(top - 0.5f)));
+        frame.wallBottom[column] = (int32_t)std::max(0.0f, std::min((float)frame.height, ceilf(bottom - 0.5f)));
+        frame.wallDistance[column] = distance;
+
+        // Diffuse term at mid-height: the face normal is along the axis the ray crossed
+        float offsetX = distance * dirX;
+        float offsetZ = distance * dirZ;
+        float lampHeight = RAYCAST_LAMP_HEIGHT + eyeY - 0.5f;
+        float toLamp = sqrtf(offsetX * offsetX + offsetZ * offsetZ + lampHeight * lampHeight);
+        frame.wallColor[column] = raycastShade(RAYCAST_WALL_COLOR, fabsf(hitX ? offsetX : offsetZ) / toLamp);
+    }
+}
+
+// Fill one row from the column spans: ceiling above wallTop, wall up to
+// wallBottom, floor below
+static void raycastFillRow(RaycastFrame& frame, int row)
+{
+    uint32_t* out = &frame.pixels[(size_t)row * frame.width];
+    const int32_t* top = frame.wallTop.data();
+    const int32_t* bottom = frame.wallBottom.data();
+    const uint32_t* wall = frame.wallColor.data();
+    uint32_t ceiling = frame.ceilingColor[row];
+    uint32_t floor = frame.floorColor[row];
+    int x = 0;
+#if defined(__AVX2__)
+    __m256i rows = _mm256_set1_epi32(row);
+    __m256i ceilings = _mm256_set1_epi32((int)ceiling);
+    __m256i floors = _mm256_set1_epi32((int)floor);
+    for (; x + 8 <= frame.width; x += 8) {
+        __m256i belowTop = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)&top[x]), rows);
+        __m256i aboveBottom = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)&bottom[x]), rows);
+        __m256i pixel = _mm256_blendv_epi8(floors, _mm256_loadu_si256((const __m256i*)&wall[x]), aboveBottom);
+        _mm256_storeu_si256((__m256i*)&out[x], _mm256_blendv_epi8(pixel, ceilings, belowTop));
+    }
+#endif
+    for (; x < frame.width; x++) {
+        uint32_t pixel = row < bottom[x] ? wall[x] : floor;
+        out[x] = row < top[x] ? ceiling : pixel;
+    }
+}
+
+// Render the view from (cameraX, eyeY, cameraZ) looking along angleDegrees
+// (the game's convention: 0 looks towards -z, 90 towards +x) into frame
+void raycastFrame(const MazeGrid& grid, float cameraX, float cameraZ, float angleDegrees, float eyeY,
+                  int width, int height, RaycastFrame& frame)
+{
+    if (frame.width != width || frame.height != height) {
+        frame.width = width;
+        frame.height = height;
+        frame.pixels.assign((size_t)width * height, 0);
+        frame.wallTop.assign(width, 0);
+        frame.wallBottom.assign(width, 0);
+        frame.wallColor.assign(width, 0);
+        frame.wallDistance.assign(width, 0.0f);
+        frame.ceilingColor.assign(height, 0);
+        frame.floorColor.assign(height, 0);
+    }
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    float angle = angleDegrees * (float)M_PI / 180.0f;
+    float focal = height * 0.5f / tanf(RAYCAST_VERTICAL_FOV * 0.5f * (float)M_PI / 180.0f);
+    float horizon = height * 0.5f;
+
+    // Floor and ceiling only change from row to row. The ceiling faces away
+    // from the lamp, so it is ambient only; rows past the far plane are background.
+    uint32_t background = 0xFF000000u | 0x010101u * (uint32_t)std::lround(RAYCAST_BACKGROUND * 255.0f);
+    uint32_t ceiling = raycastShade(RAYCAST_CEILING_COLOR, -1.0f);
+    float floorHeight = RAYCAST_LAMP_HEIGHT + eyeY;
+    for (int row = 0; row < height; row++) {
+        float fromHorizon = row + 0.5f - horizon;
+        float floorDistance = fromHorizon > 0.0f ? eyeY * focal / fromHorizon : RAYCAST_VIEW_DISTANCE * 2.0f;
+        float ceilingDistance = fromHorizon < 0.0f ? (1.0f - eyeY) * focal / -fromHorizon : RAYCAST_VIEW_DISTANCE * 2.0f;
+        frame.ceilingColor[row] = ceilingDistance <= RAYCAST_VIEW_DISTANCE ? ceiling : background;
+        frame.floorColor[row] = floorDistance <= RAYCAST_VIEW_DISTANCE
+            ? raycastShade(RAYCAST_FLOOR_COLOR, floorHeight / sqrtf(floorDistance * floorDistance + floorHeight * floorHeight))
+            : background;
+    }
+
+    // Cell i covers [i-0.5, i+0.5], so shift by half a cell to get plain floor() cells
+    float posX = cameraX + 0.5f;
+    float posZ = cameraZ + 0.5f;
+    float forwardX = sinf(angle);
+    float forwardZ = -cosf(angle);
+    ThreadPool& pool = workerPool();
+    pool.parallelFor(0, (width + RAYCAST_COLUMN_BLOCK - 1) / RAYCAST_COLUMN_BLOCK, [&](int block) {
+        int first = block * RAYCAST_COLUMN_BLOCK;
+        raycastColumns(grid, posX, posZ, forwardX, forwardZ, eyeY, focal, first,
+                       std::min(width, first + RAYCAST_COLUMN_BLOCK), frame);
+    });
+    pool.parallelFor(0, (height + RAYCAST_ROW_BLOCK - 1) / RAYCAST_ROW_BLOCK, [&](int block) {
+        int last = std::min(height, (block + 1) * RAYCAST_ROW_BLOCK);
+        for (int row = block * RAYCAST_ROW_BLOCK; row < last; row++) {
+            raycastFillRow(frame, row);
+        }
+    });
+}
@@ -0,0 +1,892 @@
+// Maze core - everything about the maze and the game simulation that doesn't
+// touch OpenGL or GLUT: the bit-packed grid, the generators, maze files, the
+// endless maze, flood fills and solvers, and the fixed-step simulation thread.
+// The game (main.cpp) and the benchmarks (maze_bench.cpp) are both built on it.
+#ifndef MAZE_CORE_H
+#define MAZE_CORE_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Maze size in cells, not counting the border walls (the grid is MAZE_SIZE + 2 square)
+extern int MAZE_SIZE;
+
+// Difficulty levels 1-3 (easy, medium, hard) and the maze size of each
+const int DIFFICULTY_EASY = 1;
+const int DIFFICULTY_MEDIUM = 2;
+const int DIFFICULTY_HARD = 3;
+int mazeSizeForDifficulty(int difficulty);
+
+// Maze grid - one bit per cell (1 = wall) in a single flat allocation.
+// Each row is padded to a whole number of 64-bit words and the padding bits are
+// kept set (wall), so whole-word operations never see stray open cells.
+// The words normally live in the grid itself, but a grid can also be attached
+// to memory it doesn't own (a memory-mapped maze file).
+class MazeGrid {
+public:
+    MazeGrid() = default;
+    MazeGrid(const MazeGrid& other) { *this = other; }
+    MazeGrid(MazeGrid&& other) noexcept { *this = std::move(other); }
+
+    MazeGrid& operator=(const MazeGrid& other)
+    {
+        if (this != &other) {
+            w = other.w;
+            h = other.h;
+            stride = other.stride;
+            storage = other.storage;
+            bits = other.bits == other.storage.data() ? storage.data() : other.bits;
+        }
+        return *this;
+    }
+
+    MazeGrid& operator=(MazeGrid&& other) noexcept
+    {
+        if (this != &other) {
+            bool owned = other.bits == other.storage.data();
+            w = other.w;
+            h = other.h;
+            stride = other.stride;
+            storage = std::move(other.storage);
+            bits = owned ? storage.data() : other.bits;
+            other.w = other.h = other.stride = 0;
+            other.storage.clear();
+            other.bits = nullptr;
+        }
+        return *this;
+    }
+
+    void resize(int width, int height, bool wall)
+    {
+        w = width;
+        h = height;
+        stride = (width + 63) / 64;
+        storage.assign((size_t)stride * height, wall ? ~0ull : 0ull);
+        bits = storage.data();
+        if (!wall) {
+            // Keep the padding bits of the last word in each row set
+            int used = width & 63;
+            if (used != 0) {
+                for (int y = 0; y < height; y++) {
+                    bits[(size_t)y * stride + stride - 1] = ~0ull << used;
+                }
+            }
+        }
+    }
+
+    // Use width x height cells stored (in the same padded layout) at external
+    void attach(uint64_t* external, int width, int height)
+    {
+        w = width;
+        h = height;
+        stride = (width + 63) / 64;
+        storage.clear();
+        storage.shrink_to_fit();
+        bits = external;
+    }
+
+    int width() const { return w; }
+    int height() const { return h; }
+    int wordsPerRow() const { return stride; }
+    size_t wordCount() const { return (size_t)stride * h; }
+    size_t memoryBytes() const { return wordCount() * sizeof(uint64_t); }
+    const uint64_t* data() const { return bits; }
+
+    // FNV-1a over the packed words, used to tell mazes apart in caches and files
+    uint64_t checksum() const
+    {
+        uint64_t hash = 1469598103934665603ull;
+        size_t count = wordCount();
+        for (size_t i = 0; i < count; i++) {
+            hash = (hash ^ bits[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool isWall(int x, int y) const
+    {
+        return (bits[(size_t)y * stride + (x >> 6)] >> (x & 63)) & 1;
+    }
+
+    void setWall(int x, int y) { bits[(size_t)y * stride + (x >> 6)] |= 1ull << (x & 63); }
+    void setOpen(int x, int y) { bits[(size_t)y * stride + (x >> 6)] &= ~(1ull << (x & 63)); }
+
+    // Raw word access to one row (bit x of the row is cell x)
+    const uint64_t* row(int y) const { return &bits[(size_t)y * stride]; }
+    uint64_t* row(int y) { return &bits[(size_t)y * stride]; }
+
+private:
+    int w = 0;
+    int h = 0;
+    int stride = 0;
+    std::vector<uint64_t> storage;
+    uint64_t* bits = nullptr;
+};
+
+// maze.isWall(x, z) - x runs along a row, z selects the row
+extern MazeGrid maze;
+extern unsigned int mazeSeed;   // RNG seed of the current maze
+
+// Maze generators ("--generator dfs|tiled"). Big mazes use the tiled one by default.
+const int GENERATOR_DFS = 0;
+const int GENERATOR_TILED = 1;
+const int TILED_GENERATOR_MIN_SIZE = 256;
+const int GENERATOR_TILE_CELLS = 64;
+extern int mazeGenerator;       // generator of the current maze
+
+// After carving, every wall between at least two open cells is removed with this
+// chance (in percent), which adds loops. The game always uses the default;
+// maze_analytics sweeps it.
+const int EXTRA_OPENING_PERCENT = 30;
+
+// Endless mode ("--endless") - MAZE_SIZE is the width and the maze goes on forever
+// along z. It is generated lazily in chunks of ENDLESS_CHUNK_ROWS rows, chunks sit
+// in a small LRU cache and are regenerated from the seed when they are needed
+// again. `maze` holds a sliding window of ENDLESS_WINDOW_CHUNKS chunks around the
+// player, so collision and rendering keep working on plain local coordinates and
+// memory stays flat however far the player travels.
+const int ENDLESS_CHUNK_ROWS = 32;
+const int ENDLESS_WINDOW_CHUNKS = 8;
+const int ENDLESS_CACHE_CHUNKS = 16;
+
+struct EndlessChunk {
+    int64_t index = 0;
+    uint64_t lastUsed = 0;
+    MazeGrid grid;
+};
+
+extern bool endlessMode;
+extern int64_t endlessWindowChunk;   // global chunk index of window row 0
+extern std::vector<EndlessChunk> endlessCache;
+extern uint64_t endlessClock;
+extern uint64_t endlessChunksGenerated;
+extern int64_t endlessFurthestRow;
+
+// Binary maze files - see MazeFileHeader in maze_core.cpp
+const uint32_t MAZE_FILE_VERSION = 2;    // 2: header padded to 64 bytes
+extern void* mazeFileMapping;
+extern size_t mazeFileMappingBytes;
+
+// Small fixed-size worker pool for the load-time passes (PVS, generation, ...).
+// parallelFor() hands out indices through an atomic counter, the calling thread
+// works too, and it returns once every index has been processed.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount)
+    {
+        for (unsigned t = 1; t < threadCount; t++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    unsigned threadCount() const { return (unsigned)workers.size() + 1; }
+
+    void parallelFor(int begin, int end, const std::function<void(int)>& body)
+    {
+        if (end <= begin) {
+            return;
+        }
+
+        // Only one loop runs on the pool at a time
+        std::lock_guard<std::mutex> callLock(callMutex);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        job = &body;
+        nextIndex = begin;
+        endIndex = end;
+        busyWorkers = (int)workers.size();
+        generation++;
+        lock.unlock();
+        wake.notify_all();
+
+        runJob();
+
+        lock.lock();
+        done.wait(lock, [this] { return busyWorkers == 0; });
+        job = nullptr;
+    }
+
+private:
+    void workerLoop()
+    {
+        unsigned seenGeneration = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+
+            lock.unlock();
+            runJob();
+            lock.lock();
+
+            if (--busyWorkers == 0) {
+                done.notify_all();
+            }
+        }
+    }
+
+    void runJob()
+    {
+        while (true) {
+            int index = nextIndex.fetch_add(1);
+            if (index >= endIndex) {
+                break;
+            }
+            (*job)(index);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex callMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* job = nullptr;
+    std::atomic<int> nextIndex{ 0 };
+    int endIndex = 0;
+    int busyWorkers = 0;
+    unsigned generation = 0;
+    bool stopping = false;
+};
+
+// The pool of the calling thread. parallelFor() calls on one pool run one at a
+// time, so the render thread, the simulation thread and the background threads
+// (JobGraph) each get a pool of their own: a level build or a batch of agents
+// never holds up a frame.
+extern thread_local bool backgroundThread;
+extern thread_local bool simulationPoolThread;
+ThreadPool& workerPool();
+
+// Work-stealing pool for many small jobs of uneven cost (the server's sessions).
+// Every thread has its own deque of job indices: run() deals the jobs out
+// round-robin, each thread takes from the back of its own deque and, once that
+// is empty, steals from the front of the others'. The calling thread works too,
+// and run() returns once every job has finished.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned threadCount);
+    ~WorkStealingPool();
+
+    unsigned threadCount() const { return (unsigned)queues.size(); }
+    uint64_t stealCount() const { return steals.load(std::memory_order_relaxed); }
+
+    void run(int jobCount, const std::function<void(int)>& job);
+
+private:
+    struct JobQueue {
+        std::mutex mutex;
+        std::deque<int> jobs;
+    };
+
+    void workerLoop(unsigned self);
+    void work(unsigned self);
+    bool takeJob(unsigned self, int& index);
+
+    std::vector<std::unique_ptr<JobQueue>> queues;     // queue 0 belongs to the caller of run()
+    std::vector<std::thread> workers;
+    std::mutex callMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* currentJob = nullptr;
+    std::atomic<uint64_t> steals{ 0 };
+    int busyWorkers = 0;
+    unsigned generation = 0;
+    bool stopping = false;
+};
+
+// Dependency graph of background jobs (building the next level). Jobs are added
+// with the jobs they have to wait for, then start() runs them on threads of its
+// own as soon as their inputs are done. The render thread polls finished()
+// rather than blocking; wait() is for callers that need the result right away.
+// A graph runs once.
+class JobGraph {
+public:
+    explicit JobGraph(unsigned threadCount);
+    ~JobGraph();
+
+    // Returns the job's id for later jobs to wait on
+    int add(std::function<void()> job, std::initializer_list<int> after = {});
+    void start();
+    void wait();
+
+    int jobCount() const { return (int)jobs.size(); }
+    int completedCount() const { return completed.load(std::memory_order_acquire); }
+    bool finished() const { return completedCount() == jobCount(); }
+
+private:
+    struct Job {
+        std::function<void()> run;
+        std::vector<int> next;      // jobs waiting on this one
+        int waitingFor = 0;         // unfinished jobs this one waits on
+    };
+
+    void workerLoop();
+
+    std::vector<Job> jobs;
+    std::deque<int> ready;
+    std::vector<std::thread> threads;
+    unsigned threadCount;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<int> completed{ 0 };
+};
+
+// Player settings
+extern float playerX;
+extern float playerY;
+extern float playerZ;
+extern float playerAngle;
+extern float playerLookUpDown;
+
+// Movement settings, per second of game time
+extern float cameraSpeed;
+extern float rotationSpeed;
+
+// Collision. The player is a circle of PLAYER_RADIUS on the floor plan and the
+// walls are the unit squares of the wall cells. A move is swept in steps shorter
+// than the radius, so no speed carries a circle through a wall, and after
+// every step the circle is pushed out of the walls around it the shortest way.
+// That only takes away the part of the move into a wall, so the player slides
+// along walls and round corners instead of stopping. sweepCircles() moves a
+// whole batch of circles with the same branch-free steps.
+const float PLAYER_RADIUS = 0.2f;
+const float COLLISION_STEP_RADII = 0.75f;   // longest sweep step, in radii
+
+// Movement controls held down, indexed by CONTROL_* (the game maps the arrow keys onto them)
+const int CONTROL_FORWARD = 0;
+const int CONTROL_BACKWARD = 1;
+const int CONTROL_TURN_LEFT = 2;
+const int CONTROL_TURN_RIGHT = 3;
+const int CONTROL_COUNT = 4;
+extern bool controlStates[CONTROL_COUNT];
+
+// Game settings
+extern bool gameFinished;
+extern bool showCongratsMessage;
+extern double finalTimeMs;      // run time of a finished maze
+extern uint64_t finishTick;     // tick the goal was reached on, 0 while running
+
+// Game loop - the simulation runs on its own thread in fixed steps of
+// 1 / tickRate seconds of steady_clock time. After every batch of steps it
+// publishes a snapshot through a lock-free triple buffer, and each frame renders
+// the newest snapshot, interpolated between its last two steps, without waiting.
+// The player state, control states and win state above are only touched by the
+// simulation thread while it runs.
+extern int tickRate;
+extern double tickSeconds;
+const int MAX_CATCH_UP_TICKS = 16;      // when further behind the rest are dropped (counted as missed)
+extern uint64_t simTick;
+extern uint64_t missedTicks;
+extern float prevPlayerX;               // player state one tick ago
+extern float prevPlayerZ;
+extern float prevPlayerAngle;
+
+struct GameSnapshot {
+    uint64_t tick = 0;
+    std::chrono::steady_clock::time_point tickTime;  // when the last tick was due
+    int64_t windowChunk = 0;            // endless window the positions are relative to
+    float playerX = 1.0f, playerZ = 1.0f, playerAngle = 0.0f;
+    float prevPlayerX = 1.0f, prevPlayerZ = 1.0f, prevPlayerAngle = 0.0f;
+    uint64_t missedTicks = 0;
+    bool gameFinished = false;
+    bool showCongratsMessage = false;
+    double finalTimeMs = 0.0;
+};
+
+// Lock-free triple buffer: the writer always owns one slot to fill, the reader
+// always owns the last complete one, and the third is handed between them with
+// a single atomic exchange, so neither side ever waits for the other.
+template <typename T>
+struct TripleBuffer {
+    static const int FRESH = 4;         // set on the shared index until the reader takes it
+
+    T& writeSlot() { return slots[back]; }
+
+    void publish()
+    {
+        back = shared.exchange(back | FRESH, std::memory_order_acq_rel) & 3;
+    }
+
+    // Newest published value (the previous one again if nothing new came in)
+    const T& read()
+    {
+        if (shared.load(std::memory_order_relaxed) & FRESH) {
+            front = shared.exchange(front, std::memory_order_acq_rel) & 3;
+        }
+        return slots[front];
+    }
+
+    void reset(const T& value)
+    {
+        slots[0] = slots[1] = slots[2] = value;
+        back = 0;
+        shared.store(1);
+        front = 2;
+    }
+
+    T slots[3];
+    std::atomic<int> shared{ 1 };
+    int back = 0;
+    int front = 2;
+};
+
+// Input events for the simulation thread, in a fixed-size single-producer /
+// single-consumer ring. The simulation drains it before every tick.
+const int INPUT_CONTROL_DOWN = 0;
+const int INPUT_CONTROL_UP = 1;
+const int INPUT_DISMISS_CONGRATS = 2;
+
+struct InputEvent {
+    uint8_t type;
+    uint8_t control;    // CONTROL_* for the control events
+};
+
+struct InputQueue {
+    static const uint32_t CAPACITY = 256;
+
+    bool push(InputEvent event)
+    {
+        uint32_t tail = writeIndex.load(std::memory_order_relaxed);
+        if (tail - readIndex.load(std::memory_order_acquire) == CAPACITY) {
+            return false;
+        }
+        events[tail % CAPACITY] = event;
+        writeIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(InputEvent& event)
+    {
+        uint32_t head = readIndex.load(std::memory_order_relaxed);
+        if (head == writeIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+        event = events[head % CAPACITY];
+        readIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    InputEvent events[CAPACITY];
+    std::atomic<uint32_t> writeIndex{ 0 };
+    std::atomic<uint32_t> readIndex{ 0 };
+};
+
+// Frame profiler ('p' shows the overlay, "--trace FILE" writes a Chrome trace).
+// PROFILE_SCOPE(stage) times the rest of the enclosing block. Every thread
+// writes its events into its own single-producer ring, which the render thread
+// drains once per frame. While the profiler is off a scope costs one relaxed
+// load; building with -DMAZE_NO_PROFILER removes the scopes altogether.
+const int PROFILE_FRAME = 0;                // all of display()
+const int PROFILE_UPDATE_FRAME_STATE = 1;
+const int PROFILE_DRAW_MAZE = 2;            // GL maze or the raycaster
+const int PROFILE_DRAW_HINTS = 3;
+const int PROFILE_DRAW_MINIMAP = 4;
+const int PROFILE_DRAW_TIMER = 5;
+const int PROFILE_DRAW_INSTRUCTIONS = 6;
+const int PROFILE_DRAW_STATS = 7;
+const int PROFILE_DRAW_PROFILER = 8;
+const int PROFILE_DRAW_CONGRATS = 9;
+const int PROFILE_DRAW_HUD_TEXT = 10;
+const int PROFILE_SWAP_BUFFERS = 11;
+const int PROFILE_SIMULATION_TICK = 12;
+const int PROFILE_PROCESS_MOVEMENT = 13;
+const int PROFILE_CHECK_COLLISION = 14;
+const int PROFILE_UPDATE_AGENTS = 15;
+const int PROFILE_DRAW_AGENTS = 16;
+const int PROFILE_STAGE_COUNT = 17;
+extern const char* const profileStageNames[PROFILE_STAGE_COUNT];
+
+const int PROFILE_THREAD_RENDER = 0;
+const int PROFILE_THREAD_SIMULATION = 1;
+const int PROFILE_THREAD_COUNT = 2;
+
+struct ProfileEvent {
+    uint64_t startNs;       // steady_clock
+    uint32_t durationNs;
+    uint8_t stage;          // PROFILE_*
+    uint8_t thread;         // PROFILE_THREAD_*
+};
+
+// Same single-producer / single-consumer ring as InputQueue; events that don't
+// fit are counted and dropped rather than making the producer wait
+struct ProfileRing {
+    static const uint32_t CAPACITY = 4096;
+
+    bool push(const ProfileEvent& event)
+    {
+        uint32_t tail = writeIndex.load(std::memory_order_relaxed);
+        if (tail - readIndex.load(std::memory_order_acquire) == CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        events[tail % CAPACITY] = event;
+        writeIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(ProfileEvent& event)
+    {
+        uint32_t head = readIndex.load(std::memory_order_relaxed);
+        if (head == writeIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+        event = events[head % CAPACITY];
+        readIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    ProfileEvent events[CAPACITY];
+    std::atomic<uint32_t> writeIndex{ 0 };
+    std::atomic<uint32_t> readIndex{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+};
+
+extern ProfileRing profileRings[PROFILE_THREAD_COUNT];
+extern std::atomic<bool> profilerEnabled;
+extern thread_local int profileThread;      // PROFILE_THREAD_* of the calling thread
+
+inline uint64_t profileNowNs()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct ProfileScope {
+    explicit ProfileScope(int stage)
+        : stage(stage), startNs(profilerEnabled.load(std::memory_order_relaxed) ? profileNowNs() : 0)
+    {
+    }
+
+    ~ProfileScope()
+    {
+        if (startNs != 0) {
+            profileRings[profileThread].push({ startNs, (uint32_t)(profileNowNs() - startNs), (uint8_t)stage, (uint8_t)profileThread });
+        }
+    }
+
+    int stage;
+    uint64_t startNs;
+};
+
+#ifndef MAZE_NO_PROFILER
+#define PROFILE_SCOPE_NAME2(line) profileScope##line
+#define PROFILE_SCOPE_NAME(line) PROFILE_SCOPE_NAME2(line)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_SCOPE_NAME(__LINE__)(stage)
+const bool PROFILER_COMPILED_IN = true;
+#else
+#define PROFILE_SCOPE(stage) ((void)0)
+const bool PROFILER_COMPILED_IN = false;
+#endif
+
+extern TripleBuffer<GameSnapshot> gameSnapshots;
+extern InputQueue inputQueue;
+extern std::thread simulationThread;
+extern std::atomic<bool> simulationRunning;
+extern std::atomic<bool> simulationPauseRequested;   // see pauseSimulation()
+extern std::atomic<bool> simulationPaused;
+
+// One game in progress with everything a run needs of its own: the maze, the
+// player, the held controls and the tick clock. The interactive game keeps its
+// single run in the globals above; the server (maze_server.cpp) steps thousands
+// of sessions side by side on a WorkStealingPool. Sessions only read shared
+// settings (cameraSpeed, rotationSpeed), so any number can step at once.
+struct GameSession {
+    uint32_t id = 0;
+    int mazeSize = 0;
+    unsigned int seed = 0;
+    MazeGrid grid;
+    float playerX = 1.0f, playerZ = 1.0f, playerAngle = 0.0f;
+    bool controls[CONTROL_COUNT] = {};
+    uint32_t inputSequence = 0;     // last input applied, echoed back to the client
+    uint64_t tick = 0;
+    uint64_t finishTick = 0;        // tick the goal was reached on, 0 while running
+};
+
+// Agents ("--agents N") - wanderers and chasers walking the maze to load-test
+// the engine. They are stored as structure-of-arrays and always walk from one
+// cell centre to the next along an axis. Every tick the worker pool updates them
+// in batches of AGENT_BATCH: a branch-free pass moves the whole batch, then a
+// second pass tests the centre point against the grid and picks a new
+// cell for those that arrived. Wanderers pick a random open neighbour (turning
+// back only at dead ends), chasers walk down a shared distance field flooded
+// from the player's cell, rebuilt when the player changes cell. Every agent has
+// its own RNG, so the result doesn't depend on the thread count. Fixed mazes only.
+const int AGENT_WANDERER = 0;
+const int AGENT_CHASER = 1;
+const int AGENT_BATCH = 1024;
+const float AGENT_MIN_SPEED = 1.0f;         // cells per second
+const float AGENT_MAX_SPEED = 2.5f;
+
+struct AgentSet {
+    size_t count = 0;
+    std::vector<float> x, z;                // position, in the player's coordinates
+    std::vector<float> dirX, dirZ;          // unit heading along one axis (or zero)
+    std::vector<float> speed;
+    std::vector<int32_t> targetX, targetZ;  // cell being walked to
+    std::vector<uint8_t> kind;              // AGENT_*
+    std::vector<uint32_t> rng;              // xorshift32 state
+
+    // Shared distance field of the chasers (floodLayers() from the player's cell)
+    std::vector<uint32_t> chaseField;
+    int chaseCellX = -1;
+    int chaseCellZ = -1;
+    size_t chasers = 0;
+};
+
+// What the renderer needs of the agents, published like GameSnapshot (the
+// vectors keep their capacity, so publishing doesn't allocate once warmed up)
+struct AgentSnapshot {
+    uint64_t tick = 0;
+    std::vector<float> x, z;
+    std::vector<uint8_t> kind;
+};
+
+extern AgentSet agents;
+extern TripleBuffer<AgentSnapshot> agentSnapshots;
+
+// Maze solver - a BFS distance field from the goal for the hint overlay ('h'),
+// and A* for point-to-point queries. All buffers are kept between calls and
+// only ever grow, so re-querying every time the player changes cell allocates
+// nothing. Cells are packed grid indices (z * maze.width() + x).
+const uint32_t SOLVER_UNREACHABLE = 0xFFFFFFFFu;
+const uint32_t SOLVER_WALL = 0xFFFFFFFEu;        // only used while the field is built
+
+struct MazeSolver {
+    // Distance field: steps from every cell to the goal, SOLVER_UNREACHABLE for
+    // walls and cells cut off from it
+    std::vector<uint32_t> distance;
+    std::vector<uint32_t> queue;
+    int goalX = -1;
+    int goalZ = -1;
+
+    // A* state. A cell's cost and parent are only valid while its stamp matches
+    // searchStamp, so a new search doesn't have to clear them.
+    std::vector<uint32_t> cost;
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> stamp;
+    std::vector<uint64_t> open;     // binary min-heap of (f << 32 | cell)
+    uint32_t searchStamp = 0;
+};
+extern MazeSolver solver;
+
+// Shape of a maze for tuning difficulty (maze_analytics). The cell counts come
+// from one bit-parallel pass that adds up the open neighbours of every cell;
+// the solution is walked down a distance field from the goal.
+struct MazeMetrics {
+    uint32_t openCells = 0;
+    uint32_t solutionLength = 0;    // steps from start to goal, SOLVER_UNREACHABLE when cut off
+    uint32_t deadEnds = 0;          // open cells with one open neighbour
+    uint32_t junctions = 0;         // open cells with three or four
+    uint32_t decisionPoints = 0;    // junctions on the solution, where the player has to choose
+    uint32_t loops = 0;             // independent cycles: passages - open cells + components
+    float branchingFactor = 0.0f;   // mean exits of a junction
+};
+
+// Flood fills - bit-parallel over the packed grid, see maze_core.cpp
+const uint32_t FLOOD_UNREACHABLE = 0xFFFFFFFFu;
+
+// Software raycaster ("--renderer raycast") for machines without a usable GPU.
+// Every wall is a unit-height block seen from eye height, so one DDA ray per
+// screen column finds all there is to draw in that column. A frame is two passes
+// over the worker pool: the rays (a block of columns per job) work out each
+// column's wall span and colour, then the rows (a block of rows per job) are
+// filled with ceiling, wall or floor by comparing the row against every span,
+// eight columns at a time on AVX2. Shading follows the fixed-function lighting
+// of the GL renderer: ambient plus the diffuse term of a lamp above the camera.
+const float RAYCAST_VERTICAL_FOV = 60.0f;       // as gluPerspective() in the game
+const float RAYCAST_VIEW_DISTANCE = 100.0f;     // its far plane
+const int RAYCAST_COLUMN_BLOCK = 64;
+const int RAYCAST_ROW_BLOCK = 16;
+
+struct RaycastFrame {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;       // RGBA8 with red in the low byte, row 0 at the top
+
+    // Per column: rows [wallTop, wallBottom) show the wall, in wallColor, at
+    // wallDistance along the view direction (RAYCAST_VIEW_DISTANCE when no wall)
+    std::vector<int32_t> wallTop;
+    std::vector<int32_t> wallBottom;
+    std::vector<uint32_t> wallColor;
+    std::vector<float> wallDistance;
+
+    // Per row: colour of the ceiling above the walls and the floor below them
+    std::vector<uint32_t> ceilingColor;
+    std::vector<uint32_t> floorColor;
+};
+
+// Baked lighting for the GL renderer. Lanterns are placed from the maze seed,
+// one in each LANTERN_SPACING x LANTERN_SPACING block of cells, and light what
+// they can see up to LANTERN_RANGE away. For every open cell the bake stores
+// the light at its four corners on the floor and on the ceiling: the ambient
+// level darkened by the walls around the corner (grid ambient occlusion), plus
+// the lanterns. The floor, the ceiling and the wall faces of a cell only have
+// vertices at those eight points, so the mesh takes its vertex colours straight
+// from the bake and drawing it needs no lighting at all. Light is RGBA8 with
+// 1.0 at LIGHT_ONE, so lanterns can brighten a surface up to twice its colour.
+const int LANTERN_SPACING = 8;
+const float LANTERN_RANGE = 5.0f;
+const float LANTERN_HEIGHT = 0.9f;           // hanging just under the ceiling
+const float LANTERN_INTENSITY = 1.1f;
+const float LIGHT_AMBIENT = 0.6f;
+const int LIGHT_ONE = 128;
+const int MAX_LIGHT_BAKE_SIZE = 1024;       // bigger mazes keep the fixed-function light
+
+struct MazeLighting {
+    int width = 0;                  // of the grid it was baked for, 0 when nothing is baked
+    int height = 0;
+    std::vector<int32_t> lanternX;  // cells holding a lantern
+    std::vector<int32_t> lanternZ;
+    std::vector<uint32_t> light;    // 8 per cell: [cell * 8 + level * 4 + dz * 2 + dx]
+
+    bool baked() const { return width > 0; }
+
+    // Light at the corner of cell (x, z) towards (+x if dx, +z if dz) on the
+    // floor (level 0) or the ceiling (level 1)
+    uint32_t at(int x, int z, int dx, int dz, int level) const
+    {
+        return light[((size_t)z * width + x) * 8 + level * 4 + dz * 2 + dx];
+    }
+};
+
+// Maze
+void generateMaze(int size, unsigned int seed, int generator);
+void generateMazeGrid(MazeGrid& grid, int size, unsigned int seed, int generator,
+                      int extraOpeningPercent = EXTRA_OPENING_PERCENT);
+int resolveGenerator(int size, int generator);
+bool saveMazeFile(const std::string& path);
+bool loadMazeFile(const std::string& path, bool verify);
+void closeMazeFile();
+bool startEndlessMaze(int width, unsigned int seed);
+void updateEndlessWindow(bool force);
+
+// Flood fills and solvers
+void floodReachable(const MazeGrid& grid, int startX, int startZ, std::vector<uint64_t>& reached);
+uint32_t floodLayers(const MazeGrid& grid, int startX, int startZ, std::vector<uint32_t>& distance);
+uint32_t floodDistance(const MazeGrid& grid, int startX, int startZ, int targetX, int targetZ);
+uint32_t floodComponents(const MazeGrid& grid, std::vector<uint32_t>& label);
+size_t buildDistanceField(int goalX, int goalZ);
+size_t buildDistanceField(const MazeGrid& grid, MazeSolver& state, int goalX, int goalZ);
+bool followDistanceField(int x, int z, int maxSteps, std::vector<int>& path);
+bool findPath(int startX, int startZ, int goalX, int goalZ, std::vector<int>& path);
+MazeMetrics measureMaze(const MazeGrid& grid, MazeSolver& scratch);
+
+// Lighting
+void placeLanterns(const MazeGrid& grid, unsigned int seed, MazeLighting& lighting);
+void bakeLighting(const MazeGrid& grid, unsigned int seed, MazeLighting& lighting);
+
+// Software rendering
+void raycastFrame(const MazeGrid& grid, float cameraX, float cameraZ, float angleDegrees, float eyeY,
+                  int width, int height, RaycastFrame& frame);
+
+// Input recording ("--record FILE" / "--replay FILE") - every input event the
+// simulation applies, with the tick it was applied before, plus what it takes to
+// rebuild the same maze. The simulation only changes through these events, so
+// running the same ticks again (headless, as fast as the CPU goes) has to end
+// in the recorded state; fixed mazes only, endless window slides follow frames.
+const uint32_t RECORDING_FILE_VERSION = 1;
+const float REPLAY_POSITION_TOLERANCE = 1e-4f;  // allows for builds that contract to FMA differently
+
+struct InputRecording {
+    int mazeSize = 0;
+    unsigned int seed = 0;
+    int generator = GENERATOR_DFS;
+    int difficulty = 0;             // DIFFICULTY_*, 0 when the size was given directly
+    int tickRate = 0;
+    uint64_t mazeChecksum = 0;
+    float startX = 0.0f, startZ = 0.0f, startAngle = 0.0f;
+
+    // Per event: ticks since the previous event as a LEB128 varint, then one
+    // byte of type << 4 | control
+    std::vector<uint8_t> events;
+    uint64_t eventCount = 0;
+    uint64_t lastEventTick = 0;
+
+    // How the recorded session ended
+    uint64_t tickCount = 0;
+    uint64_t finishTick = 0;
+    float finalX = 0.0f, finalZ = 0.0f, finalAngle = 0.0f;
+};
+
+struct ReplayResult {
+    uint64_t ticks = 0;
+    double elapsedMs = 0.0;
+    float finalX = 0.0f, finalZ = 0.0f, finalAngle = 0.0f;
+    uint64_t finishTick = 0;
+    bool stateMatches = false;      // final position and heading within REPLAY_POSITION_TOLERANCE
+    bool finishMatches = false;     // goal reached on the same tick (or not at all in both)
+};
+
+extern InputRecording inputRecording;
+extern bool recordingInput;
+
+void startRecording(int difficulty);
+void finishRecording();
+bool saveRecording(const InputRecording& recording, const std::string& path);
+bool loadRecording(const std::string& path, InputRecording& recording);
+ReplayResult replayRecording(const InputRecording& recording);
+
+// Agents
+void spawnAgents(AgentSet& set, size_t count, float chaserFraction, unsigned int seed);
+void updateAgents(AgentSet& set, float dt, float targetX, float targetZ);
+void publishAgentSnapshot(const AgentSet& set, uint64_t tick);
+
+// Profiler
+bool writeChromeTrace(const std::vector<ProfileEvent>& events, uint64_t droppedEvents, const std::string& path);
+
+// Simulation
+bool circleHitsWall(const MazeGrid& grid, float x, float z, float radius);
+bool checkCollision(const MazeGrid& grid, float x, float z);
+bool checkCollision(float x, float y, float z);
+void sweepCircles(const MazeGrid& grid, float radius, size_t count, float* x, float* z, const float* moveX,
+                  const float* moveZ);
+void moveCircle(const MazeGrid& grid, float radius, float& x, float& z, float moveX, float moveZ);
+void movePlayer(const MazeGrid& grid, const bool* controls, float dt, float& x, float& z, float& angle);
+void processMovement(float dt);
+void applyInputEvent(InputEvent event);
+void simulationStep();
+void simulationTick();
+void publishSnapshot(std::chrono::steady_clock::time_point tickTime);
+void simulationLoop();
+void startSimulation();
+void stopSimulation();
+void pauseSimulation();
+void resumeSimulation();
+void resetRun();
+
+// Sessions
+void startSession(GameSession& session, uint32_t id, int size, unsigned int seed);
+void stepSession(GameSession& session, float dt);
+
+#endif
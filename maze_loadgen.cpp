@@ -0,0 +1,307 @@
+// Load generator for maze_server. Opens a number of connections, creates the
+// sessions spread over them, then keeps sending each session random controls
+// at a fixed rate and times how long each input takes to come back in a STATE
+// (the server echoes the last input sequence it applied).
+//
+//   maze_loadgen [--socket PATH] [--sessions N] [--connections N] [--size N]
+//                [--seconds N] [--input-rate HZ] [--seed N]
+//
+// Prints the input-to-state latency percentiles, the states received per second
+// and how many sessions reached the goal. Exit code is 1 when the server could
+// not be reached or refused sessions.
+#include "maze_core.h"
+#include "maze_protocol.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+typedef std::chrono::steady_clock Clock;
+
+struct LoadSession {
+    uint32_t id = 0;                // 0 until CREATED arrives
+    int connection = 0;
+    uint32_t sequence = 0;          // last input sent
+    Clock::time_point sentTime;
+    bool waiting = false;           // the last input hasn't come back yet
+    bool finished = false;
+    Clock::time_point nextInput;
+};
+
+struct LoadConnection {
+    int fd = -1;
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+};
+
+std::vector<LoadConnection> connections;
+std::vector<LoadSession> sessions;
+std::unordered_map<uint32_t, size_t> sessionIndex;     // server session id -> index into sessions
+std::vector<double> latencyMs;
+uint64_t statesReceived = 0;
+int sessionsCreated = 0;
+int sessionsRefused = 0;
+bool connectionLost = false;
+
+static int connectToServer(const std::string& path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+static void flushConnection(LoadConnection& connection)
+{
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        ssize_t n = send(connection.fd, connection.output.data() + written, connection.output.size() - written, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                connectionLost = true;
+            }
+            break;
+        }
+        written += (size_t)n;
+    }
+    connection.output.erase(connection.output.begin(), connection.output.begin() + written);
+}
+
+static void handleMessage(const uint8_t* message, Clock::time_point now)
+{
+    if (message[0] == MSG_CREATED) {
+        size_t index = getField<uint32_t>(message, 1);
+        uint32_t id = getField<uint32_t>(message, 5);
+        if (index >= sessions.size()) {
+            return;
+        }
+        if (id == 0) {
+            sessionsRefused++;
+            return;
+        }
+        sessions[index].id = id;
+        sessionIndex[id] = index;
+        sessionsCreated++;
+    }
+    else if (message[0] == MSG_STATE) {
+        statesReceived++;
+        auto found = sessionIndex.find(getField<uint32_t>(message, 1));
+        if (found == sessionIndex.end()) {
+            return;
+        }
+        LoadSession& session = sessions[found->second];
+        if (session.waiting && getField<uint32_t>(message, 9) == session.sequence) {
+            latencyMs.push_back(std::chrono::duration<double, std::milli>(now - session.sentTime).count());
+            session.waiting = false;
+        }
+        session.finished = (message[MSG_STATE_BYTES - 1] & STATE_FINISHED) != 0;
+    }
+}
+
+static void readConnection(LoadConnection& connection, Clock::time_point now)
+{
+    uint8_t buffer[65536];
+    while (true) {
+        ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            connectionLost = true;
+            return;
+        }
+        if (n < 0) {
+            return;
+        }
+
+        connection.input.insert(connection.input.end(), buffer, buffer + n);
+        size_t offset = 0;
+        while (offset < connection.input.size()) {
+            int bytes = messageBytes(connection.input[offset]);
+            if (bytes == 0) {
+                connectionLost = true;
+                return;
+            }
+            if (offset + bytes > connection.input.size()) {
+                break;
+            }
+            handleMessage(&connection.input[offset], now);
+            offset += bytes;
+        }
+        connection.input.erase(connection.input.begin(), connection.input.begin() + offset);
+    }
+}
+
+static double latencyPercentile(const std::vector<double>& sorted, double percentile)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    return sorted[std::min(sorted.size() - 1, (size_t)(percentile / 100.0 * sorted.size()))];
+}
+
+int main(int argc, char** argv)
+{
+    std::string socketPath = MAZE_SERVER_DEFAULT_SOCKET;
+    int sessionCount = 1000;
+    int connectionCount = 4;
+    int size = 21;
+    double seconds = 10.0;
+    double inputRate = 2.0;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        }
+        else if (arg == "--sessions" && i + 1 < argc) {
+            sessionCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--connections" && i + 1 < argc) {
+            connectionCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--size" && i + 1 < argc) {
+            size = std::max(2, std::min(65535, atoi(argv[++i])));
+        }
+        else if (arg == "--seconds" && i + 1 < argc) {
+            seconds = std::max(0.1, atof(argv[++i]));
+        }
+        else if (arg == "--input-rate" && i + 1 < argc) {
+            inputRate = std::max(0.1, atof(argv[++i]));
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = (unsigned)strtoul(argv[++i], NULL, 10);
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    connectionCount = std::min(connectionCount, sessionCount);
+    for (int c = 0; c < connectionCount; c++) {
+        int fd = connectToServer(socketPath);
+        if (fd < 0) {
+            fprintf(stderr, "Could not connect to %s: %s\n", socketPath.c_str(), strerror(errno));
+            return 1;
+        }
+        connections.emplace_back();
+        connections.back().fd = fd;
+    }
+
+    // Create every session up front, the request id being its index here
+    std::mt19937 rng(seed);
+    auto inputInterval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / inputRate));
+    auto startTime = Clock::now();
+    sessions.resize(sessionCount);
+    for (int s = 0; s < sessionCount; s++) {
+        LoadSession& session = sessions[s];
+        session.connection = s % connectionCount;
+        session.nextInput = startTime + std::chrono::duration_cast<Clock::duration>(
+                                            inputInterval * std::uniform_real_distribution<double>(0.0, 1.0)(rng));
+        std::vector<uint8_t>& out = connections[session.connection].output;
+        out.push_back(MSG_CREATE);
+        putField<uint32_t>(out, (uint32_t)s);
+        putField<uint16_t>(out, (uint16_t)size);
+        putField<uint32_t>(out, seed + (uint32_t)s);
+    }
+
+    // Controls are picked like a player would hold them: mostly forward, sometimes turning
+    std::uniform_int_distribution<int> pick(0, 7);
+    const uint8_t controlChoices[8] = {
+        1 << CONTROL_FORWARD, 1 << CONTROL_FORWARD, 1 << CONTROL_FORWARD,
+        (1 << CONTROL_FORWARD) | (1 << CONTROL_TURN_LEFT), (1 << CONTROL_FORWARD) | (1 << CONTROL_TURN_RIGHT),
+        1 << CONTROL_TURN_LEFT, 1 << CONTROL_TURN_RIGHT, 0
+    };
+
+    auto endTime = startTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    uint64_t inputsSent = 0;
+    std::vector<pollfd> pollFds(connections.size());
+    while (!connectionLost) {
+        auto now = Clock::now();
+        if (now >= endTime) {
+            break;
+        }
+
+        for (LoadSession& session : sessions) {
+            if (session.id == 0 || now < session.nextInput) {
+                continue;
+            }
+            session.nextInput += inputInterval;
+            session.sequence++;
+            session.sentTime = now;
+            session.waiting = true;
+            std::vector<uint8_t>& out = connections[session.connection].output;
+            out.push_back(MSG_INPUT);
+            putField<uint32_t>(out, session.id);
+            putField<uint32_t>(out, session.sequence);
+            out.push_back(controlChoices[pick(rng)]);
+            inputsSent++;
+        }
+
+        for (size_t c = 0; c < connections.size(); c++) {
+            if (!connections[c].output.empty()) {
+                flushConnection(connections[c]);
+            }
+            pollFds[c] = pollfd{ connections[c].fd, (short)(POLLIN | (connections[c].output.empty() ? 0 : POLLOUT)), 0 };
+        }
+        if (poll(pollFds.data(), pollFds.size(), 1) <= 0) {
+            continue;
+        }
+        now = Clock::now();
+        for (size_t c = 0; c < connections.size(); c++) {
+            if (pollFds[c].revents & (POLLIN | POLLHUP | POLLERR)) {
+                readConnection(connections[c], now);
+            }
+        }
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - startTime).count();
+
+    for (const LoadSession& session : sessions) {
+        if (session.id != 0) {
+            std::vector<uint8_t>& out = connections[session.connection].output;
+            out.push_back(MSG_CLOSE);
+            putField<uint32_t>(out, session.id);
+        }
+    }
+    int finished = 0;
+    for (const LoadSession& session : sessions) {
+        finished += session.finished;
+    }
+    for (LoadConnection& connection : connections) {
+        fcntl(connection.fd, F_SETFL, fcntl(connection.fd, F_GETFL, 0) & ~O_NONBLOCK);
+        flushConnection(connection);
+        close(connection.fd);
+    }
+
+    std::sort(latencyMs.begin(), latencyMs.end());
+    printf("%d sessions (%d refused) of size %d on %zu connections for %.1f s\n", sessionsCreated, sessionsRefused, size,
+           connections.size(), elapsed);
+    printf("%llu inputs sent, %llu states received (%.0f/s), %d sessions finished\n", (unsigned long long)inputsSent,
+           (unsigned long long)statesReceived, statesReceived / elapsed, finished);
+    printf("input to state latency over %zu inputs: p50 %.2f / p95 %.2f / p99 %.2f / max %.2f ms\n", latencyMs.size(),
+           latencyPercentile(latencyMs, 50.0), latencyPercentile(latencyMs, 95.0), latencyPercentile(latencyMs, 99.0),
+           latencyMs.empty() ? 0.0 : latencyMs.back());
+
+    if (connectionLost) {
+        fprintf(stderr, "Lost the connection to the server\n");
+        return 1;
+    }
+    return sessionsRefused > 0 ? 1 : 0;
+}
@@ -0,0 +1,81 @@
+// Wire protocol between maze_server and its clients (maze_loadgen, bots) over
+// a local stream socket. Every message is a one-byte type followed by a fixed
+// payload for that type, little-endian, with no padding, so a reader only has
+// to look at the first byte to know how much to wait for.
+//
+//   client -> server
+//     CREATE   u32 request, u16 maze size, u32 seed       new session; answered by CREATED
+//     INPUT    u32 session, u32 sequence, u8 controls      held controls (bit CONTROL_*) from the next tick on
+//     CLOSE    u32 session
+//   server -> client
+//     CREATED  u32 request, u32 session (0 = refused), u16 maze size
+//     STATE    u32 session, u32 tick, u32 input sequence, f32 x, f32 z, u16 angle, u8 flags
+//
+// STATE goes out on the tick after an INPUT was applied and every few ticks in
+// between. Its input sequence is the last one applied, so clients can time
+// input-to-state latency. Angles are in 1/65536 of a turn.
+#ifndef MAZE_PROTOCOL_H
+#define MAZE_PROTOCOL_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+const char* const MAZE_SERVER_DEFAULT_SOCKET = "/tmp/maze_server.sock";
+
+const uint8_t MSG_CREATE = 1;
+const uint8_t MSG_INPUT = 2;
+const uint8_t MSG_CLOSE = 3;
+const uint8_t MSG_CREATED = 4;
+const uint8_t MSG_STATE = 5;
+
+const uint8_t STATE_FINISHED = 1;           // STATE flags
+
+const int MSG_CREATE_BYTES = 1 + 4 + 2 + 4;
+const int MSG_INPUT_BYTES = 1 + 4 + 4 + 1;
+const int MSG_CLOSE_BYTES = 1 + 4;
+const int MSG_CREATED_BYTES = 1 + 4 + 4 + 2;
+const int MSG_STATE_BYTES = 1 + 4 + 4 + 4 + 4 + 4 + 2 + 1;
+
+// Size of a message of the given type, 0 for unknown types
+inline int messageBytes(uint8_t type)
+{
+    switch (type) {
+    case MSG_CREATE: return MSG_CREATE_BYTES;
+    case MSG_INPUT: return MSG_INPUT_BYTES;
+    case MSG_CLOSE: return MSG_CLOSE_BYTES;
+    case MSG_CREATED: return MSG_CREATED_BYTES;
+    case MSG_STATE: return MSG_STATE_BYTES;
+    default: return 0;
+    }
+}
+
+// Field access on a message buffer. Both ends are assumed little-endian, which
+// every machine the game builds on is.
+template <typename T>
+inline void putField(std::vector<uint8_t>& out, T value)
+{
+    uint8_t bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+inline T getField(const uint8_t* message, int offset)
+{
+    T value;
+    memcpy(&value, message + offset, sizeof(T));
+    return value;
+}
+
+inline uint16_t encodeAngle(float degrees)
+{
+    return (uint16_t)(int)(degrees * (65536.0f / 360.0f));
+}
+
+inline float decodeAngle(uint16_t angle)
+{
+    return angle * (360.0f / 65536.0f);
+}
+
+#endif
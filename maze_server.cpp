@@ -0,0 +1,411 @@
+// Headless game server: many independent maze runs (GameSession) in one process,
+// advanced together on a fixed tick. Every tick the sessions are cut into batches
+// that run on a work-stealing pool, then the states that are due go out to the
+// clients that own them. Clients connect over a Unix domain socket and speak the
+// binary protocol in maze_protocol.h; maze_loadgen is a load generator for it.
+//
+//   maze_server [--socket PATH] [--threads N] [--tick-rate N] [--state-every N]
+//               [--max-sessions N] [--max-size N]
+//
+// Every few seconds, and on SIGINT/SIGTERM, it prints the session count, tick
+// time percentiles and how many session ticks one core gets through per second.
+#include "maze_core.h"
+#include "maze_protocol.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+const int SESSION_BATCH = 64;                   // sessions per pool job
+const size_t MAX_PENDING_OUTPUT = 8u << 20;     // clients that fall further behind are dropped
+const double STATS_INTERVAL_SECONDS = 5.0;
+const int TICK_HISTORY = 4096;                  // tick times kept for the percentiles
+
+struct Connection {
+    int fd = -1;
+    std::vector<uint8_t> input;     // bytes of a message not yet complete
+    std::vector<uint8_t> output;    // bytes the socket didn't take yet
+    bool closing = false;
+};
+
+struct ServerSession {
+    GameSession game;
+    int connection = 0;             // owner, index into connections
+    bool stateDue = true;           // send a STATE after the next tick
+};
+
+std::vector<Connection> connections;
+std::vector<ServerSession> sessions;
+std::unordered_map<uint32_t, size_t> sessionIndex;      // session id -> index into sessions
+uint32_t nextSessionId = 1;
+
+int stateEveryTicks = 12;
+int maxSessions = 100000;
+int maxMazeSize = 255;
+
+// Tick statistics since the last report
+std::vector<double> tickMs;
+double busyMs = 0.0;
+uint64_t sessionTicks = 0;
+uint64_t ticksRun = 0;
+uint64_t missedServerTicks = 0;
+uint64_t bytesSent = 0;
+
+volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int)
+{
+    stopRequested = 1;
+}
+
+static void setNonBlocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+// Write as much pending output as the socket takes
+static void flushConnection(Connection& connection)
+{
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        ssize_t n = send(connection.fd, connection.output.data() + written, connection.output.size() - written, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                connection.closing = true;
+            }
+            break;
+        }
+        written += (size_t)n;
+    }
+    bytesSent += written;
+    connection.output.erase(connection.output.begin(), connection.output.begin() + written);
+    if (connection.output.size() > MAX_PENDING_OUTPUT) {
+        connection.closing = true;
+    }
+}
+
+static void removeSession(size_t index)
+{
+    sessionIndex.erase(sessions[index].game.id);
+    if (index + 1 != sessions.size()) {
+        sessions[index] = std::move(sessions.back());
+        sessionIndex[sessions[index].game.id] = index;
+    }
+    sessions.pop_back();
+}
+
+// One complete message from connection c
+static void handleMessage(int c, const uint8_t* message)
+{
+    Connection& connection = connections[c];
+    switch (message[0]) {
+    case MSG_CREATE: {
+        uint32_t request = getField<uint32_t>(message, 1);
+        int size = std::max(2, std::min(maxMazeSize, (int)getField<uint16_t>(message, 5)));
+        uint32_t seed = getField<uint32_t>(message, 7);
+        uint32_t id = 0;
+        if ((int)sessions.size() < maxSessions) {
+            id = nextSessionId++;
+            sessions.emplace_back();
+            startSession(sessions.back().game, id, size, seed);
+            sessions.back().connection = c;
+            sessionIndex[id] = sessions.size() - 1;
+        }
+        connection.output.push_back(MSG_CREATED);
+        putField<uint32_t>(connection.output, request);
+        putField<uint32_t>(connection.output, id);
+        putField<uint16_t>(connection.output, (uint16_t)size);
+        break;
+    }
+    case MSG_INPUT: {
+        auto found = sessionIndex.find(getField<uint32_t>(message, 1));
+        if (found == sessionIndex.end() || sessions[found->second].connection != c) {
+            break;
+        }
+        ServerSession& session = sessions[found->second];
+        uint8_t controls = message[9];
+        for (int control = 0; control < CONTROL_COUNT; control++) {
+            session.game.controls[control] = (controls >> control) & 1;
+        }
+        session.game.inputSequence = getField<uint32_t>(message, 5);
+        session.stateDue = true;
+        break;
+    }
+    case MSG_CLOSE: {
+        auto found = sessionIndex.find(getField<uint32_t>(message, 1));
+        if (found != sessionIndex.end() && sessions[found->second].connection == c) {
+            removeSession(found->second);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Read what the client sent and handle every complete message in it
+static void readConnection(int c)
+{
+    uint8_t buffer[65536];
+    while (true) {
+        ssize_t n = recv(connections[c].fd, buffer, sizeof(buffer), 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            connections[c].closing = true;
+            return;
+        }
+        if (n < 0) {
+            return;
+        }
+
+        std::vector<uint8_t>& input = connections[c].input;
+        input.insert(input.end(), buffer, buffer + n);
+        size_t offset = 0;
+        while (offset < input.size()) {
+            int bytes = messageBytes(input[offset]);
+            if (bytes == 0 || input[offset] >= MSG_CREATED) {
+                // Not a client message - the stream can't be trusted any more
+                connections[c].closing = true;
+                return;
+            }
+            if (offset + bytes > input.size()) {
+                break;
+            }
+            handleMessage(c, &input[offset]);
+            offset += bytes;
+        }
+        input.erase(input.begin(), input.begin() + offset);
+    }
+}
+
+// Drop closed connections along with their sessions. Connections after the
+// removed one move down, so the owners of sessions are renumbered.
+static void closeConnections()
+{
+    for (int c = (int)connections.size() - 1; c >= 0; c--) {
+        if (!connections[c].closing) {
+            continue;
+        }
+        close(connections[c].fd);
+        for (size_t s = sessions.size(); s-- > 0;) {
+            if (sessions[s].connection == c) {
+                removeSession(s);
+            }
+        }
+        for (ServerSession& session : sessions) {
+            if (session.connection > c) {
+                session.connection--;
+            }
+        }
+        connections.erase(connections.begin() + c);
+    }
+}
+
+// Step every session once on the pool, then queue the states that are due
+static void runTick(WorkStealingPool& pool, float dt)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    int batches = (int)((sessions.size() + SESSION_BATCH - 1) / SESSION_BATCH);
+    pool.run(batches, [&](int batch) {
+        size_t first = (size_t)batch * SESSION_BATCH;
+        size_t last = std::min(sessions.size(), first + SESSION_BATCH);
+        for (size_t s = first; s < last; s++) {
+            stepSession(sessions[s].game, dt);
+        }
+    });
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    ticksRun++;
+    sessionTicks += sessions.size();
+    busyMs += elapsed;
+    if (tickMs.size() < (size_t)TICK_HISTORY) {
+        tickMs.push_back(elapsed);
+    }
+    else {
+        tickMs[ticksRun % TICK_HISTORY] = elapsed;
+    }
+
+    for (ServerSession& session : sessions) {
+        const GameSession& game = session.game;
+        if (!session.stateDue && game.tick % stateEveryTicks != 0) {
+            continue;
+        }
+        session.stateDue = false;
+        std::vector<uint8_t>& out = connections[session.connection].output;
+        out.push_back(MSG_STATE);
+        putField<uint32_t>(out, game.id);
+        putField<uint32_t>(out, (uint32_t)game.tick);
+        putField<uint32_t>(out, game.inputSequence);
+        putField<float>(out, game.playerX);
+        putField<float>(out, game.playerZ);
+        putField<uint16_t>(out, encodeAngle(game.playerAngle));
+        out.push_back(game.finishTick != 0 ? STATE_FINISHED : 0);
+    }
+}
+
+static double tickPercentile(std::vector<double>& sorted, double percentile)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    return sorted[std::min(sorted.size() - 1, (size_t)(percentile / 100.0 * sorted.size()))];
+}
+
+static void printStats(const WorkStealingPool& pool, double seconds)
+{
+    static uint64_t reportedSteals = 0;
+    unsigned threads = pool.threadCount();
+    std::vector<double> sorted = tickMs;
+    std::sort(sorted.begin(), sorted.end());
+    double coreSeconds = busyMs / 1000.0 * threads;
+    printf("%zu sessions on %zu connections, %llu ticks in %.1f s (%llu missed), tick p50 %.3f / p95 %.3f / p99 %.3f / max %.3f ms\n",
+           sessions.size(), connections.size(), (unsigned long long)ticksRun, seconds, (unsigned long long)missedServerTicks,
+           tickPercentile(sorted, 50.0), tickPercentile(sorted, 95.0), tickPercentile(sorted, 99.0),
+           sorted.empty() ? 0.0 : sorted.back());
+    printf("  %.0f session ticks per core-second, %.1f%% of the time ticking, %llu batches stolen, %.1f KB/s out\n",
+           coreSeconds > 0.0 ? sessionTicks / coreSeconds : 0.0, busyMs / (seconds * 10.0),
+           (unsigned long long)(pool.stealCount() - reportedSteals), bytesSent / 1024.0 / seconds);
+    reportedSteals = pool.stealCount();
+    fflush(stdout);
+
+    tickMs.clear();
+    busyMs = 0.0;
+    sessionTicks = 0;
+    ticksRun = 0;
+    missedServerTicks = 0;
+    bytesSent = 0;
+}
+
+int main(int argc, char** argv)
+{
+    std::string socketPath = MAZE_SERVER_DEFAULT_SOCKET;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            threads = (unsigned)std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--tick-rate" && i + 1 < argc) {
+            tickRate = std::max(1, atoi(argv[++i]));
+            tickSeconds = 1.0 / tickRate;
+        }
+        else if (arg == "--state-every" && i + 1 < argc) {
+            stateEveryTicks = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--max-sessions" && i + 1 < argc) {
+            maxSessions = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--max-size" && i + 1 < argc) {
+            maxMazeSize = std::max(2, std::min(65535, atoi(argv[++i])));
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || socketPath.size() >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Could not create the socket %s\n", socketPath.c_str());
+        return 1;
+    }
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        fprintf(stderr, "Could not listen on %s: %s\n", socketPath.c_str(), strerror(errno));
+        return 1;
+    }
+    setNonBlocking(listener);
+    signal(SIGINT, requestStop);
+    signal(SIGTERM, requestStop);
+
+    WorkStealingPool pool(threads);
+    printf("Maze server on %s, %u threads, %d Hz, state every %d ticks\n", socketPath.c_str(), pool.threadCount(), tickRate,
+           stateEveryTicks);
+    fflush(stdout);
+
+    auto tickDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(tickSeconds));
+    auto nextTick = std::chrono::steady_clock::now() + tickDuration;
+    auto statsTime = std::chrono::steady_clock::now();
+    std::vector<pollfd> pollFds;
+
+    while (!stopRequested) {
+        // Ticks that are due, dropping the backlog like the game's simulation does
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextTick) {
+            int ticks = (int)((now - nextTick) / tickDuration) + 1;
+            if (ticks > MAX_CATCH_UP_TICKS) {
+                missedServerTicks += ticks - MAX_CATCH_UP_TICKS;
+                nextTick += (ticks - MAX_CATCH_UP_TICKS) * tickDuration;
+                ticks = MAX_CATCH_UP_TICKS;
+            }
+            for (int t = 0; t < ticks; t++) {
+                runTick(pool, (float)tickSeconds);
+                nextTick += tickDuration;
+            }
+            for (Connection& connection : connections) {
+                flushConnection(connection);
+            }
+            closeConnections();
+        }
+
+        double statsSeconds = std::chrono::duration<double>(now - statsTime).count();
+        if (statsSeconds >= STATS_INTERVAL_SECONDS) {
+            printStats(pool, statsSeconds);
+            statsTime = now;
+        }
+
+        // Wait for the network until the next tick is due
+        pollFds.assign(1, pollfd{ listener, POLLIN, 0 });
+        for (const Connection& connection : connections) {
+            pollFds.push_back(pollfd{ connection.fd, (short)(POLLIN | (connection.output.empty() ? 0 : POLLOUT)), 0 });
+        }
+        int timeoutMs = (int)std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                        nextTick - std::chrono::steady_clock::now()).count());
+        if (poll(pollFds.data(), pollFds.size(), timeoutMs) <= 0) {
+            continue;
+        }
+
+        if (pollFds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listener, NULL, NULL)) >= 0) {
+                setNonBlocking(fd);
+                connections.emplace_back();
+                connections.back().fd = fd;
+            }
+        }
+        for (size_t p = 1; p < pollFds.size(); p++) {
+            int c = (int)p - 1;
+            if (pollFds[p].revents & (POLLIN | POLLHUP | POLLERR)) {
+                readConnection(c);
+            }
+            if (!connections[c].output.empty()) {
+                flushConnection(connections[c]);
+            }
+        }
+        closeConnections();
+    }
+
+    printStats(pool, std::max(0.001, std::chrono::duration<double>(std::chrono::steady_clock::now() - statsTime).count()));
+    for (Connection& connection : connections) {
+        close(connection.fd);
+    }
+    close(listener);
+    unlink(socketPath.c_str());
+    return 0;
+}